@@ -0,0 +1,485 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+
+#ifdef __APPLE__
+#include <SDL/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#include "depixel/depixel.h"
+#include "depixel/parallel.h"
+
+//  Modo batch, sin ventana ni SDL_Init: sólo se usa SDL para leer los bmp.
+//
+//      depixel --batch [--threads N] [--band-height N] [--spline-iterations N] [--spline-tolerance T] [--scale S]
+//                      [--svg] [--snapshot | --resume] [--cache DIR [--cache-size MB]] [--tile-size N]
+//                      <directorio de salida> <entrada> [<entrada> ...]
+//
+//  Con --band-height cada imagen se procesa por bandas de N filas (depixelBanded), para imágenes que no caben enteras
+// en memoria; las curvas se escriben según salen, en el mismo formato. --spline-iterations y --spline-tolerance fijan
+// cuánto se optimizan las splines (0 iteraciones para no optimizarlas). Con --scale se escribe además
+// <nombre>.depixel.bmp con las celdas dibujadas a esa escala (rasterizeCells), y con --svg <nombre>.svg con las
+// regiones de color y las curvas (saveSvg). Ninguna de las dos vale con --band-height.
+//
+//  Con --snapshot se guarda también <nombre>.dpxs con el grafo de similitud y las celdas (saveSnapshot), y con
+// --resume las entradas son esos .dpxs en lugar de bmp: el pipeline sigue desde ellos (depixelFromSnapshot), para
+// repetir sólo las etapas de después (curvas, splines, salida). Tampoco valen con --band-height.
+//
+//  Con --cache los resultados se guardan en DIR indexados por el contenido de la imagen (depixelCached), y las imágenes
+// repetidas se sacan de ahí sin calcular nada. --cache-size limita lo que ocupa (1024 MB por defecto); al pasarse se
+// borran las entradas usadas hace más tiempo. No vale con --band-height ni con --resume.
+//
+//  Con --tile-size las imágenes se tratan como mapas de tiles de N x N (depixelTiled): el grafo de similitud y las
+// celdas se calculan una vez por tile distinto, y por cada imagen se informa de cuántos había. No vale con
+// --band-height, --resume ni --cache.
+//
+//  Cada entrada puede ser un fichero .bmp, un directorio (se procesan todos sus .bmp) o @lista, un fichero de texto
+// con una ruta por línea. Por cada imagen se escribe <directorio de salida>/<nombre>.curves.
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+//  Sin distinguir mayúsculas (extension en minúsculas, con el punto).
+static bool hasExtension(const std::filesystem::path& path, const char* wanted)
+{
+    std::string extension = path.extension().string();
+
+    for(unsigned int i = 0; i < extension.size(); ++i)
+    {
+        extension[i] = tolower(extension[i]);
+    }
+
+    return extension == wanted;
+}
+
+static void collectInputs(const std::string& arg, const char* extension, std::vector<std::string>& inputs)
+{
+    if(!arg.empty() && arg[0] == '@')
+    {
+        std::ifstream list(arg.substr(1).c_str());
+        std::string line;
+
+        while(std::getline(list, line))
+        {
+            if(!line.empty() && line[line.size() - 1] == '\r')
+            {
+                line.erase(line.size() - 1);
+            }
+
+            if(!line.empty())
+            {
+                collectInputs(line, extension, inputs);
+            }
+        }
+    }
+    else if(std::filesystem::is_directory(arg))
+    {
+        std::vector<std::string> files;
+
+        for(std::filesystem::directory_iterator it(arg); it != std::filesystem::directory_iterator(); ++it)
+        {
+            if(it->is_regular_file() && hasExtension(it->path(), extension))
+            {
+                files.push_back(it->path().string());
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+        inputs.insert(inputs.end(), files.begin(), files.end());
+    }
+    else
+    {
+        inputs.push_back(arg);
+    }
+}
+
+//  Carga un bmp y lo convierte a 32 bits 0xAARRGGBB, que es lo que espera libdepixel (SDL_LoadBMP devuelve la
+// profundidad original del fichero).
+static SDL_Surface* loadImage32(const char* fileName)
+{
+    SDL_Surface* image = SDL_LoadBMP(fileName);
+
+    if(!image)
+    {
+        return 0;
+    }
+
+    SDL_Surface* converted = SDL_CreateRGBSurface(SDL_SWSURFACE, image->w, image->h, 32,
+                                                  0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    if(converted)
+    {
+        SDL_Surface* aux = SDL_ConvertSurface(image, converted->format, SDL_SWSURFACE);
+        SDL_FreeSurface(converted);
+        converted = aux;
+    }
+
+    SDL_FreeSurface(image);
+
+    return converted;
+}
+
+//  Dibuja las celdas de result a la escala scale y las guarda en un bmp de 32 bits.
+static bool saveScaledImage(const char* fileName, const DepixelResult& result, float scale)
+{
+    int width, height;
+    uint32_t* pixels = rasterizeCells(result, scale, width, height, 1);
+
+    if(!pixels)
+    {
+        return false;
+    }
+
+    SDL_Surface* image = SDL_CreateRGBSurfaceFrom(pixels, width, height, 32, width * 4,
+                                                  0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    bool ok = image && SDL_SaveBMP(image, fileName) == 0;
+
+    if(image)
+    {
+        SDL_FreeSurface(image);
+    }
+
+    delete [] pixels;
+
+    return ok;
+}
+
+static int printUsage(void)
+{
+    printf("Usage: depixel --batch [--threads N] [--band-height N] [--spline-iterations N] [--spline-tolerance T] [--scale S]\n"
+           "                       [--svg] [--snapshot | --resume] [--cache DIR [--cache-size MB]] [--tile-size N]\n"
+           "                       <output dir> <input.bmp | input.dpxs | dir | @list> ...\n");
+    return 1;
+}
+
+int runBatch(int argc, char** argv)
+{
+    unsigned int numThreads = 0;
+    int bandHeight = 0;
+    int splineIterations = -1;
+    float splineTolerance = -1.0f;
+    float scale = 0.0f;
+    bool svg = false;
+    bool snapshot = false;
+    bool resume = false;
+    const char* cacheDir = 0;
+    unsigned long long cacheSize = 1024;
+    int tileSize = 0;
+    int arg = 0;
+
+    while(arg < argc && strncmp(argv[arg], "--", 2) == 0)
+    {
+        //  Opciones sin valor.
+        if(strcmp(argv[arg], "--svg") == 0)
+        {
+            svg = true;
+            ++arg;
+            continue;
+        }
+        else if(strcmp(argv[arg], "--snapshot") == 0)
+        {
+            snapshot = true;
+            ++arg;
+            continue;
+        }
+        else if(strcmp(argv[arg], "--resume") == 0)
+        {
+            resume = true;
+            ++arg;
+            continue;
+        }
+
+        if(arg + 1 >= argc)
+        {
+            return printUsage();
+        }
+
+        if(strcmp(argv[arg], "--threads") == 0)
+        {
+            numThreads = atoi(argv[arg + 1]);
+        }
+        else if(strcmp(argv[arg], "--band-height") == 0)
+        {
+            bandHeight = atoi(argv[arg + 1]);
+
+            if(bandHeight <= 0)
+            {
+                return printUsage();
+            }
+        }
+        else if(strcmp(argv[arg], "--spline-iterations") == 0)
+        {
+            splineIterations = atoi(argv[arg + 1]);
+        }
+        else if(strcmp(argv[arg], "--spline-tolerance") == 0)
+        {
+            splineTolerance = atof(argv[arg + 1]);
+        }
+        else if(strcmp(argv[arg], "--cache") == 0)
+        {
+            cacheDir = argv[arg + 1];
+        }
+        else if(strcmp(argv[arg], "--cache-size") == 0)
+        {
+            cacheSize = strtoull(argv[arg + 1], 0, 10);
+        }
+        else if(strcmp(argv[arg], "--tile-size") == 0)
+        {
+            tileSize = atoi(argv[arg + 1]);
+
+            if(tileSize <= 0)
+            {
+                return printUsage();
+            }
+        }
+        else if(strcmp(argv[arg], "--scale") == 0)
+        {
+            scale = atof(argv[arg + 1]);
+
+            if(!(scale > 0.0f))
+            {
+                return printUsage();
+            }
+        }
+        else
+        {
+            return printUsage();
+        }
+
+        arg += 2;
+    }
+
+    if(argc - arg < 2 || ((scale > 0.0f || svg || snapshot || resume) && bandHeight > 0) || (snapshot && resume)
+       || (cacheDir && (bandHeight > 0 || resume)) || (tileSize > 0 && (bandHeight > 0 || resume || cacheDir)))
+    {
+        return printUsage();
+    }
+
+    std::filesystem::path outputDir(argv[arg++]);
+    std::vector<std::string> inputs;
+
+    for(; arg < argc; ++arg)
+    {
+        collectInputs(argv[arg], resume ? ".dpxs" : ".bmp", inputs);
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(outputDir, error);
+
+    if(!std::filesystem::is_directory(outputDir))
+    {
+        printf("Unable to create output directory %s\n", outputDir.string().c_str());
+        return 1;
+    }
+
+    if(numThreads == 0)
+    {
+        numThreads = workerCount();
+    }
+
+    //  Las trazas de depuración del algoritmo van a std::cout; en batch las silenciamos y los informes van por stdio.
+    std::cout.rdbuf(0);
+
+    initAlgorithm();
+    resetDepixelCounters();
+
+    DepixelCache* cache = 0;
+
+    if(cacheDir && !(cache = openDepixelCache(cacheDir, cacheSize << 20)))
+    {
+        printf("Unable to open cache directory %s\n", cacheDir);
+        return 1;
+    }
+
+    DepixelSplineOptions splineOptions;
+
+    if(splineIterations >= 0)
+    {
+        splineOptions.maxIterations = splineIterations;
+    }
+
+    if(splineTolerance >= 0.0f)
+    {
+        splineOptions.tolerance = splineTolerance;
+    }
+
+    printf("Processing %u images with %u threads (%s similarity kernel)\n", (unsigned int)inputs.size(), numThreads,
+           similarityKernelName());
+
+    std::atomic<int> numErrors(0);
+    std::atomic<unsigned long long> numTiles(0);
+    std::atomic<unsigned long long> numUniqueTiles(0);
+    Clock::time_point start = Clock::now();
+
+    parallelFor((int)inputs.size(), [&](int i)
+    {
+        Clock::time_point startImage = Clock::now();
+        const char* fileName = inputs[i].c_str();
+
+        std::string baseName = (outputDir / std::filesystem::path(inputs[i]).stem()).string();
+        std::string outputName = baseName + ".curves";
+        std::string imageName = baseName + ".depixel.bmp";
+        std::string svgName = baseName + ".svg";
+        std::string snapshotName = baseName + ".dpxs";
+
+        SDL_Surface* image = 0;
+        DepixelSnapshot inputSnapshot;
+        DepixelResult result;
+        DepixelTileStats tileStats = {0, 0, 0};
+        bool ok;
+
+        if(resume)
+        {
+            if(!loadSnapshot(fileName, inputSnapshot))
+            {
+                printf("%s: unable to load snapshot\n", fileName);
+                ++numErrors;
+                return;
+            }
+
+            ok = depixelFromSnapshot(inputSnapshot, result, 1, splineOptions);
+        }
+        else
+        {
+            image = loadImage32(fileName);
+
+            if(!image)
+            {
+                printf("%s: unable to load bitmap\n", fileName);
+                ++numErrors;
+                return;
+            }
+
+            if(bandHeight > 0)
+            {
+                if(!saveCurvesBanded(outputName.c_str(), (uint32_t*)(image->pixels), image->w, image->h, image->pitch,
+                                     bandHeight))
+                {
+                    printf("%s: unable to process or write %s\n", fileName, outputName.c_str());
+                    ++numErrors;
+                }
+                else
+                {
+                    printf("%s: %dx%d, %.2f ms\n", fileName, image->w, image->h, elapsedMs(startImage));
+                }
+
+                SDL_FreeSurface(image);
+                return;
+            }
+
+            if(tileSize > 0)
+            {
+                ok = depixelTiled((uint32_t*)(image->pixels), image->w, image->h, image->pitch, tileSize, result,
+                                  tileStats, 1, splineOptions);
+            }
+            else
+            {
+                ok = depixelCached(cache, (uint32_t*)(image->pixels), image->w, image->h, image->pitch, result, 1,
+                                   splineOptions);
+            }
+        }
+
+        if(!ok)
+        {
+            printf("%s: invalid image\n", fileName);
+            ++numErrors;
+        }
+        else if(!saveCurves(outputName.c_str(), result))
+        {
+            printf("%s: unable to write %s\n", fileName, outputName.c_str());
+            ++numErrors;
+        }
+        else if(snapshot && !saveSnapshot(snapshotName.c_str(), (uint32_t*)(image->pixels), image->pitch, result))
+        {
+            printf("%s: unable to write %s\n", fileName, snapshotName.c_str());
+            ++numErrors;
+        }
+        else if(scale > 0.0f && !saveScaledImage(imageName.c_str(), result, scale))
+        {
+            printf("%s: unable to write %s\n", fileName, imageName.c_str());
+            ++numErrors;
+        }
+        else if(svg && !saveSvg(svgName.c_str(), result))
+        {
+            printf("%s: unable to write %s\n", fileName, svgName.c_str());
+            ++numErrors;
+        }
+        else if(tileSize > 0)
+        {
+            //  Se informa de los tiles distintos de las celdas: se agrupan con los cruces ya resueltos, que pueden
+            // separar tiles que en el grafo eran iguales.
+            printf("%s: %dx%d, %u curves, %u of %u tiles unique (%.1fx), %.2f ms\n", fileName, result.width,
+                   result.height, (unsigned int)result.curves.size(), tileStats.uniqueCellTiles, tileStats.tiles,
+                   tileStats.uniqueCellTiles > 0 ? (double)tileStats.tiles / tileStats.uniqueCellTiles : 0.0,
+                   elapsedMs(startImage));
+
+            numTiles += tileStats.tiles;
+            numUniqueTiles += tileStats.uniqueCellTiles;
+        }
+        else
+        {
+            printf("%s: %dx%d, %u curves, %.2f ms\n", fileName, result.width, result.height,
+                   (unsigned int)result.curves.size(), elapsedMs(startImage));
+        }
+
+        freeDepixelResult(result);
+
+        if(image)
+        {
+            SDL_FreeSurface(image);
+        }
+        else
+        {
+            freeSnapshot(inputSnapshot);
+        }
+    }, numThreads);
+
+    double seconds = elapsedMs(start) / 1000.0;
+    int numImages = (int)inputs.size() - numErrors;
+
+    printf("%d images in %.3f s (%.1f images/s), %d errors\n", numImages, seconds,
+           seconds > 0.0 ? numImages / seconds : 0.0, (int)numErrors);
+
+    if(tileSize > 0)
+    {
+        printf("tiles: %llu of %llu unique (%.1fx)\n", (unsigned long long)numUniqueTiles, (unsigned long long)numTiles,
+               numUniqueTiles > 0 ? (double)numTiles / numUniqueTiles : 0.0);
+    }
+
+    if(cache)
+    {
+        DepixelCacheStats stats = depixelCacheStats(cache);
+
+        printf("cache: %llu hits, %llu misses, %llu evictions, %llu entries, %.1f MB\n", stats.hits, stats.misses,
+               stats.evictions, stats.entries, stats.bytes / (1024.0 * 1024.0));
+
+        closeDepixelCache(cache);
+    }
+
+    //  Sólo si libdepixel se ha compilado con -DDEPIXEL_COUNTERS=1.
+    if(depixelCountersEnabled())
+    {
+        for(int counter = 0; counter < DEPIXEL_COUNTER_COUNT; ++counter)
+        {
+            printf("  %-32s %llu\n", depixelCounterName((DepixelCounter)counter),
+                   depixelCounterValue((DepixelCounter)counter));
+        }
+    }
+
+    return numErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,310 @@
+#include <cstdio>
+#include <algorithm>
+#include <list>
+#include <map>
+#include <vector>
+
+#include "depixel.h"
+#include "trace.h"
+
+//  Pipeline por bandas horizontales para imágenes que no caben enteras en memoria: en cada momento sólo hay
+// intermedios (YUV, grafo de similitud, celdas, malla...) de una banda más sus filas de contexto, y las curvas se
+// entregan según se terminan.
+//
+//  El grafo de similitud de cada banda se calcula con al menos DEPIXEL_BAND_MARGIN filas de contexto por arriba y por
+// abajo. La primera y la última fila del contexto no tienen sus vecinas, así que su grafo no es el de la imagen
+// completa; el resto sí. Con 5 filas bastaría para la ventana 8x8 de la heurística de píxeles dispersos, pero la de
+// curvas mide cadenas de valencia 2 que pueden ser arbitrariamente largas: si alguna de las que mide en los cruces de
+// la banda llega a una de esas filas, el contexto de ese lado se dobla y la banda se repite. Así el grafo es siempre
+// el mismo que con depixel, y la memoria de una banda crece sólo con las curvas que pasan por sus cruces.
+#ifndef DEPIXEL_BAND_MARGIN
+    #define DEPIXEL_BAND_MARGIN 16
+#endif
+
+#if DEPIXEL_BAND_MARGIN < 5
+    #error DEPIXEL_BAND_MARGIN tiene que ser al menos 5
+#endif
+
+//  Las celdas de una fila dependen del grafo de las filas de al lado, y las curvas de una fila de las celdas de las
+// filas de al lado: las curvas van VORONOI_BAND_MARGIN filas por detrás del grafo.
+#define VORONOI_BAND_MARGIN 2
+
+typedef std::list<std::vector<Point> >::iterator PendingCurve;
+
+//  Trozos de curva que acaban en una costura entre bandas, esperando al trozo de la banda siguiente. ends tiene cada
+// extremo de costura con su trozo.
+struct PendingCurves
+{
+    std::list<std::vector<Point> > curves;
+    std::map<Point, PendingCurve> ends;
+};
+
+//  Junta piece con los trozos pendientes que acaban en sus extremos de costura (seamFront, seamBack). Si la curva
+// queda completa se entrega; si no, se queda pendiente.
+static unsigned int stitchCurve(PendingCurves& pending, std::vector<Point>& piece, bool seamFront, bool seamBack,
+                                CurveCallback callback, void* userData)
+{
+    std::map<Point, PendingCurve>::iterator end;
+    PendingCurve other;
+
+    if(seamFront && (end = pending.ends.find(piece.front())) != pending.ends.end())
+    {
+        other = end->second;
+        pending.ends.erase(end);
+
+        //  El pendiente tiene que acabar donde empieza piece.
+        if(other->back() != piece.front())
+        {
+            std::reverse(other->begin(), other->end());
+        }
+
+        other->insert(other->end(), piece.begin() + 1, piece.end());
+        piece.swap(*other);
+
+        //  El otro extremo del pendiente sigue esperando si estaba en la tabla.
+        end = pending.ends.find(piece.front());
+        seamFront = end != pending.ends.end() && end->second == other;
+
+        if(seamFront)
+        {
+            pending.ends.erase(end);
+        }
+
+        pending.curves.erase(other);
+    }
+
+    if(seamBack && (end = pending.ends.find(piece.back())) != pending.ends.end())
+    {
+        other = end->second;
+        pending.ends.erase(end);
+
+        if(other->front() != piece.back())
+        {
+            std::reverse(other->begin(), other->end());
+        }
+
+        piece.insert(piece.end(), other->begin() + 1, other->end());
+
+        end = pending.ends.find(piece.back());
+        seamBack = end != pending.ends.end() && end->second == other;
+
+        if(seamBack)
+        {
+            pending.ends.erase(end);
+        }
+
+        pending.curves.erase(other);
+    }
+
+    //  Un lazo que cruzaba costuras se cierra al juntar su último trozo.
+    if(piece.front() != piece.back() && (seamFront || seamBack))
+    {
+        other = pending.curves.insert(pending.curves.end(), std::vector<Point>());
+        other->swap(piece);
+
+        if(seamFront)
+        {
+            pending.ends[other->front()] = other;
+        }
+
+        if(seamBack)
+        {
+            pending.ends[other->back()] = other;
+        }
+
+        return 0;
+    }
+
+    callback(&piece[0], piece.size(), userData);
+
+    return 1;
+}
+
+static inline const uint32_t* pixelRow(const uint32_t* pixels, int stride, int y)
+{
+    return (const uint32_t*)((const unsigned char*)pixels + (size_t)y * stride);
+}
+
+//  Ejecuta el pipeline por bandas de bandHeight filas y llama a callback con cada curva (en coordenadas de la imagen
+// completa, 4 unidades por píxel) según se completa. La memoria depende de bandHeight y de width, no de height (salvo
+// las curvas que cruzan muchas bandas, que se guardan hasta que acaban).
+bool depixelBanded(const uint32_t* pixels, int width, int height, int stride, int bandHeight,
+                   CurveCallback callback, void* userData)
+{
+    if(!pixels || !callback || width <= 0 || height <= 0 || bandHeight <= 0 || stride < (int)(width * sizeof(uint32_t)))
+    {
+        return false;
+    }
+
+    //  Grafo de similitud final de las filas [graphBegin, graphBegin + graph.size() / width).
+    std::vector<uint8_t> graph;
+    int graphBegin = 0;
+    int curveRow = 0;
+
+    PendingCurves pending;
+    std::vector<uint8_t> seamEnds;
+    std::vector<Point> piece;
+    unsigned int numCurves = 0;
+
+    int y0, y1, c0, c1, s0, s1, limit, drop, x, marginAbove, marginBelow, rowBegin, rowEnd;
+    uint8_t* similarityGraph;
+
+    for(y0 = 0; y0 < height; y0 = y1)
+    {
+        y1 = std::min(height, y0 + bandHeight);
+        marginAbove = DEPIXEL_BAND_MARGIN;
+        marginBelow = DEPIXEL_BAND_MARGIN;
+
+        //  La banda decide los cruces de los bloques con la fila de arriba en [y0, y1).
+        for(;;)
+        {
+            c0 = std::max(0, y0 - marginAbove);
+            c1 = std::min(height, y1 + marginBelow);
+
+            unsigned int* yuvSurface = rgba2yuv(pixelRow(pixels, stride, c0), width, c1 - c0, stride);
+            similarityGraph = hqxGetSimplifiedSimilarityGraph(yuvSurface, width, c1 - c0);
+            delete [] yuvSurface;
+
+            findCrossCurveRows(similarityGraph, width, c1 - c0, y0 - c0, y1 - c0, rowBegin, rowEnd);
+
+            bool growAbove = c0 > 0 && rowBegin < rowEnd && rowBegin == 0;
+            bool growBelow = c1 < height && rowBegin < rowEnd && rowEnd == c1 - c0;
+
+            if(!growAbove && !growBelow)
+            {
+                break;
+            }
+
+            delete [] similarityGraph;
+
+            marginAbove = growAbove ? marginAbove * 2 : marginAbove;
+            marginBelow = growBelow ? marginBelow * 2 : marginBelow;
+
+            DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Banda [" << y0 << ", " << y1 << "): contexto de " << marginAbove
+                                                << " filas arriba y " << marginBelow << " abajo");
+        }
+
+        simplifyCrossesSimilarityGraph(similarityGraph, width, c1 - c0);
+
+        graph.insert(graph.end(), similarityGraph + (y0 - c0) * width, similarityGraph + (y1 - c0) * width);
+        delete [] similarityGraph;
+
+        //  Los cruces entre la última fila de la banda anterior y la primera de ésta se han resuelto en las dos
+        // bandas; manda la anterior, que es la que ya está en el grafo final.
+        if(y0 > 0)
+        {
+            const uint8_t* above = &graph[(y0 - 1 - graphBegin) * width];
+            uint8_t* row = &graph[(y0 - graphBegin) * width];
+
+            for(x = 0; x < width; ++x)
+            {
+                row[x] = (row[x] & 0xFA) | (x > 0 && (above[x - 1] & 0x80) ? 0x01 : 0)
+                                         | (x < width - 1 && (above[x + 1] & 0x20) ? 0x04 : 0);
+            }
+        }
+
+        limit = y1 == height ? height : y1 - VORONOI_BAND_MARGIN;
+
+        if(limit <= curveRow)
+        {
+            continue;
+        }
+
+        //  Celdas, malla y curvas de las filas [curveRow, limit), con sus filas de contexto.
+        s0 = std::max(graphBegin, curveRow - VORONOI_BAND_MARGIN);
+        s1 = std::min(y1, limit + VORONOI_BAND_MARGIN);
+
+        VoronoiGraph voronoiGraph = extractVoronoiGraph(&graph[(s0 - graphBegin) * width], width, s1 - s0);
+        VoronoiMesh voronoiMesh = buildVoronoiMesh(voronoiGraph, pixelRow(pixels, stride, s0), stride);
+        CurveList curves = extractCurves(voronoiMesh, curveRow - s0, limit - s0, seamEnds);
+
+        freeVoronoiMesh(voronoiMesh);
+        freeVoronoiGraph(voronoiGraph);
+
+        for(unsigned int i = 0; i < curves.size(); ++i)
+        {
+            piece.assign(curves.curve(i), curves.curve(i) + curves.curveSize(i));
+
+            for(unsigned int v = 0; v < piece.size(); ++v)
+            {
+                piece[v].second += s0 << 2;
+            }
+
+            numCurves += stitchCurve(pending, piece, seamEnds[i] & 0x01, seamEnds[i] & 0x02, callback, userData);
+        }
+
+        curveRow = limit;
+
+        //  Del grafo sólo hace falta el contexto de las próximas curvas.
+        drop = curveRow - VORONOI_BAND_MARGIN - graphBegin;
+
+        if(drop > 0)
+        {
+            graph.erase(graph.begin(), graph.begin() + drop * width);
+            graphBegin += drop;
+        }
+
+        DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Banda [" << y0 << ", " << y1 << "): " << curves.size() << " trozos, " << pending.curves.size() << " curvas pendientes");
+    }
+
+    //  Con todas las bandas hechas no debería quedar nada pendiente.
+    for(PendingCurve it = pending.curves.begin(); it != pending.curves.end(); ++it)
+    {
+        callback(&(*it)[0], it->size(), userData);
+        ++numCurves;
+    }
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_IMAGES, 1);
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_PIXELS, (unsigned long long)width * height);
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_CURVES, numCurves);
+
+    return true;
+}
+
+struct CurveWriter
+{
+    FILE* file;
+    unsigned int numCurves;
+};
+
+static void writeCurve(const Point* vertices, unsigned int numVertices, void* userData)
+{
+    CurveWriter* writer = (CurveWriter*)userData;
+
+    fprintf(writer->file, "%u", numVertices);
+
+    for(unsigned int v = 0; v < numVertices; ++v)
+    {
+        fprintf(writer->file, " %d,%d", vertices[v].first, vertices[v].second);
+    }
+
+    fprintf(writer->file, "\n");
+
+    ++writer->numCurves;
+}
+
+//  Como saveCurves, pero procesando la imagen por bandas y escribiendo cada curva según sale. El número de curvas de
+// la cabecera se reserva con ancho fijo y se rellena al acabar.
+bool saveCurvesBanded(const char* fileName, const uint32_t* pixels, int width, int height, int stride, int bandHeight)
+{
+    CurveWriter writer = {fopen(fileName, "w"), 0};
+
+    if(!writer.file)
+    {
+        return false;
+    }
+
+    fprintf(writer.file, "# depixel curves %d %d ", width, height);
+
+    long countPosition = ftell(writer.file);
+
+    fprintf(writer.file, "%10u\n", 0u);
+
+    bool ok = depixelBanded(pixels, width, height, stride, bandHeight, writeCurve, &writer);
+
+    ok = ok && fseek(writer.file, countPosition, SEEK_SET) == 0;
+    ok = ok && fprintf(writer.file, "%-10u", writer.numCurves) == 10;
+    ok = ok && !ferror(writer.file);
+
+    return (fclose(writer.file) == 0) && ok;
+}
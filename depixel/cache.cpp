@@ -0,0 +1,515 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+    #include <process.h>
+    #define getpid _getpid
+#else
+    #include <unistd.h>
+#endif
+
+#include "depixel.h"
+#include "hash.h"
+#include "trace.h"
+
+//  Caché en disco de resultados completos, para las imágenes que se repiten byte a byte (fotogramas duplicados,
+// recoloreados deshechos...). La clave es un hash de los píxeles y de los parámetros del pipeline, y cada entrada es un
+// fichero <clave>.dpxc con todo el DepixelResult (grafo, celdas, malla, curvas y splines) en arrays planos, así que un
+// acierto no ejecuta ninguna etapa. Al acertar se comparan además los píxeles con los colores de la malla, de modo que
+// una colisión del hash sólo cuesta un fallo.
+//
+//  Las entradas se escriben a un fichero temporal y se renombran, para que otro hilo (u otro proceso sobre el mismo
+// directorio) nunca lea una a medias. El temporal lleva el proceso y el hilo que lo escriben, para que dos escrituras
+// de la misma entrada no compartan fichero. Cuando el directorio pasa de maxBytes se borran las usadas hace más tiempo; el
+// orden de uso se guarda en la fecha de modificación de los ficheros para que dure entre ejecuciones.
+//
+//  Cualquier cambio en el formato o en lo que calcula el pipeline tiene que subir DEPIXEL_CACHE_VERSION.
+#define DEPIXEL_CACHE_MAGIC     "DPXCACHE"
+#define DEPIXEL_CACHE_VERSION   1
+#define DEPIXEL_CACHE_EXTENSION ".dpxc"
+
+struct CacheEntryHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint32_t numCellVertices;
+    uint32_t numMeshWords;
+    uint32_t numCurveVertices;
+    uint32_t numCurveOffsets;
+    uint32_t numSplinePoints;
+    uint32_t numSplineOffsets;
+    uint32_t numSplines;
+    uint64_t key;
+};
+
+typedef std::list<uint64_t> CacheRecency;
+
+struct CacheEntry
+{
+    CacheRecency::iterator recency;
+    unsigned long long size;
+};
+
+struct DepixelCache
+{
+    std::string directory;
+    unsigned long long maxBytes;
+
+    mutable std::mutex lock;
+    std::map<uint64_t, CacheEntry> entries;
+    CacheRecency recency;                       //  De la más reciente a la más antigua.
+    unsigned long long bytes;
+
+    std::atomic<unsigned long long> hits;
+    std::atomic<unsigned long long> misses;
+    std::atomic<unsigned long long> evictions;
+};
+
+//  Hash de los píxeles (sin el relleno de las filas) y de todo lo que cambia el resultado.
+static uint64_t cacheKey(const uint32_t* pixels, int width, int height, int stride,
+                         const DepixelSplineOptions& splineOptions)
+{
+    uint32_t toleranceBits;
+
+    memcpy(&toleranceBits, &splineOptions.tolerance, sizeof(toleranceBits));
+
+    uint64_t hash = hashWord(DEPIXEL_CACHE_VERSION, ((uint64_t)width << 32) | (uint32_t)height);
+    hash = hashWord(hash, ((uint64_t)splineOptions.maxIterations << 32) | toleranceBits);
+
+    for(int y = 0; y < height; ++y)
+    {
+        const uint32_t* row = (const uint32_t*)((const unsigned char*)pixels + (size_t)y * stride);
+        int x = 0;
+
+        for(; x + 1 < width; x += 2)
+        {
+            hash = hashWord(hash, ((uint64_t)row[x + 1] << 32) | row[x]);
+        }
+
+        if(x < width)
+        {
+            hash = hashWord(hash, row[x]);
+        }
+    }
+
+    return hashFinish(hash);
+}
+
+static void evictEntries(DepixelCache* cache);
+
+static std::string entryName(const DepixelCache* cache, uint64_t key)
+{
+    char name[32];
+
+    snprintf(name, sizeof(name), "%016llx" DEPIXEL_CACHE_EXTENSION, (unsigned long long)key);
+
+    return (std::filesystem::path(cache->directory) / name).string();
+}
+
+//  Abre (o crea) la caché del directorio directory, que se mantiene por debajo de maxBytes. Se cierra con
+// closeDepixelCache.
+DepixelCache* openDepixelCache(const char* directory, unsigned long long maxBytes)
+{
+    std::error_code error;
+
+    std::filesystem::create_directories(directory, error);
+
+    if(!std::filesystem::is_directory(directory, error))
+    {
+        return 0;
+    }
+
+    DepixelCache* cache = new DepixelCache();
+    std::vector<std::pair<std::filesystem::file_time_type, uint64_t> > found;
+
+    cache->directory = directory;
+    cache->maxBytes = maxBytes;
+    cache->bytes = 0;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+
+    for(std::filesystem::directory_iterator it(directory, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+    {
+        std::string name = it->path().filename().string();
+        unsigned long long key;
+        char extension[8];
+
+        if(it->is_regular_file(error) && name.size() == 16 + strlen(DEPIXEL_CACHE_EXTENSION)
+           && sscanf(name.c_str(), "%16llx%7s", &key, extension) == 2 && strcmp(extension, DEPIXEL_CACHE_EXTENSION) == 0)
+        {
+            CacheEntry entry;
+
+            entry.size = it->file_size(error);
+            cache->entries[key] = entry;
+            cache->bytes += entry.size;
+            found.push_back(std::make_pair(it->last_write_time(error), (uint64_t)key));
+        }
+    }
+
+    std::sort(found.begin(), found.end());
+
+    for(unsigned int i = 0; i < found.size(); ++i)
+    {
+        cache->recency.push_front(found[i].second);
+        cache->entries[found[i].second].recency = cache->recency.begin();
+    }
+
+    //  Por si se abre con un límite menor que la última vez.
+    evictEntries(cache);
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Cache " << directory << ": " << cache->entries.size() << " entradas, " << cache->bytes << " bytes");
+
+    return cache;
+}
+
+void closeDepixelCache(DepixelCache* cache)
+{
+    delete cache;
+}
+
+DepixelCacheStats depixelCacheStats(const DepixelCache* cache)
+{
+    DepixelCacheStats stats;
+    std::lock_guard<std::mutex> guard(cache->lock);
+
+    stats.hits = cache->hits;
+    stats.misses = cache->misses;
+    stats.evictions = cache->evictions;
+    stats.entries = cache->entries.size();
+    stats.bytes = cache->bytes;
+
+    return stats;
+}
+
+static bool readArray(FILE* file, void* data, size_t size)
+{
+    return size == 0 || fread(data, 1, size, file) == size;
+}
+
+static bool writeArray(FILE* file, const void* data, size_t size)
+{
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+//  Comprueba que offsets (numOffsets valores) parte numItems elementos en trozos seguidos: empieza en 0, no baja y
+// acaba en numItems. Sin offsets no puede haber elementos.
+static bool validOffsets(const unsigned int* offsets, size_t numOffsets, size_t numItems)
+{
+    if(numOffsets == 0)
+    {
+        return numItems == 0;
+    }
+
+    if(offsets[0] != 0 || offsets[numOffsets - 1] != numItems)
+    {
+        return false;
+    }
+
+    for(size_t i = 1; i < numOffsets; ++i)
+    {
+        if(offsets[i] < offsets[i - 1])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//  Los índices de la malla no se salen de sus arrays.
+static bool validMesh(const VoronoiMesh& mesh, unsigned int numPixels)
+{
+    for(unsigned int h = 0; h < mesh.numHalfEdges; ++h)
+    {
+        if(mesh.origins[h] >= mesh.numVertices || mesh.nexts[h] >= mesh.numHalfEdges || mesh.faces[h] >= numPixels
+           || (mesh.twins[h] != VORONOI_NO_TWIN && mesh.twins[h] >= mesh.numHalfEdges))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//  Carga la entrada en result si es de pixels. Todo se reserva como en las etapas, así que result se libera con
+// freeDepixelResult como siempre. Los tamaños de la cabecera se comprueban contra el del fichero antes de reservar
+// nada, y los offsets y los índices de la malla después de leerlos: una entrada corrupta o truncada es un fallo más.
+static bool loadEntry(const std::string& fileName, uint64_t key, const uint32_t* pixels, int width, int height,
+                      int stride, DepixelResult& result)
+{
+    std::error_code error;
+    uint64_t fileSize = std::filesystem::file_size(fileName, error);
+
+    if(error)
+    {
+        return false;
+    }
+
+    FILE* file = fopen(fileName.c_str(), "rb");
+    CacheEntryHeader header;
+
+    if(!file)
+    {
+        return false;
+    }
+
+    unsigned int numPixels = width * height;
+
+    if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, DEPIXEL_CACHE_MAGIC, sizeof(header.magic)) != 0
+       || header.version != DEPIXEL_CACHE_VERSION || header.key != key || header.width != width || header.height != height)
+    {
+        fclose(file);
+        return false;
+    }
+
+    //  En 64 bits: con los contadores de 32 bits de la cabecera ninguna suma se desborda.
+    uint64_t numMeshWords = (uint64_t)header.numCellVertices * 4 + numPixels + ((uint64_t)header.numCellVertices + 3) / 4;
+    uint64_t entrySize = sizeof(header) + numPixels + ((uint64_t)numPixels + 1) * sizeof(unsigned int)
+                       + (uint64_t)header.numCellVertices * 2 + numMeshWords * sizeof(uint32_t)
+                       + (uint64_t)header.numCurveVertices * sizeof(Point)
+                       + (uint64_t)header.numCurveOffsets * sizeof(unsigned int)
+                       + (uint64_t)header.numSplinePoints * (2 * sizeof(float) + 1)
+                       + (uint64_t)header.numSplineOffsets * sizeof(unsigned int) + header.numSplines;
+
+    if(header.numMeshWords != numMeshWords || entrySize != fileSize
+       || header.numSplines != (header.numSplineOffsets > 0 ? header.numSplineOffsets - 1 : 0))
+    {
+        fclose(file);
+        return false;
+    }
+
+    result.similarityGraph = new uint8_t[numPixels];
+    result.voronoiGraph.width = width;
+    result.voronoiGraph.height = height;
+    result.voronoiGraph.offsets = new unsigned int[numPixels + 1 + (header.numCellVertices + 1) / 2];
+    result.voronoiGraph.vertices = (int8_t*)(result.voronoiGraph.offsets + numPixels + 1);
+    result.voronoiMesh.width = width;
+    result.voronoiMesh.height = height;
+    result.voronoiMesh.numVertices = (width + 1) * (height + 1) * VORONOI_VERTEX_SLOTS;
+    result.voronoiMesh.numHalfEdges = header.numCellVertices;
+    result.voronoiMesh.origins = new uint32_t[header.numMeshWords];
+    result.voronoiMesh.twins = result.voronoiMesh.origins + header.numCellVertices;
+    result.voronoiMesh.nexts = result.voronoiMesh.twins + header.numCellVertices;
+    result.voronoiMesh.faces = result.voronoiMesh.nexts + header.numCellVertices;
+    result.voronoiMesh.faceColors = result.voronoiMesh.faces + header.numCellVertices;
+    result.voronoiMesh.visible = (uint8_t*)(result.voronoiMesh.faceColors + numPixels);
+    result.curves.vertices.resize(header.numCurveVertices);
+    result.curves.offsets.resize(header.numCurveOffsets);
+    result.splines.x.resize(header.numSplinePoints);
+    result.splines.y.resize(header.numSplinePoints);
+    result.splines.flags.resize(header.numSplinePoints);
+    result.splines.offsets.resize(header.numSplineOffsets);
+    result.splines.closed.resize(header.numSplines);
+
+    bool ok = readArray(file, result.similarityGraph, numPixels)
+           && readArray(file, result.voronoiGraph.offsets, (numPixels + 1) * sizeof(unsigned int))
+           && readArray(file, result.voronoiGraph.vertices, header.numCellVertices * 2)
+           && readArray(file, result.voronoiMesh.origins, header.numMeshWords * sizeof(uint32_t))
+           && readArray(file, result.curves.vertices.data(), header.numCurveVertices * sizeof(Point))
+           && readArray(file, result.curves.offsets.data(), header.numCurveOffsets * sizeof(unsigned int))
+           && readArray(file, result.splines.x.data(), header.numSplinePoints * sizeof(float))
+           && readArray(file, result.splines.y.data(), header.numSplinePoints * sizeof(float))
+           && readArray(file, result.splines.flags.data(), header.numSplinePoints)
+           && readArray(file, result.splines.offsets.data(), header.numSplineOffsets * sizeof(unsigned int))
+           && readArray(file, result.splines.closed.data(), header.numSplines);
+
+    fclose(file);
+
+    ok = ok && validOffsets(result.voronoiGraph.offsets, numPixels + 1, header.numCellVertices)
+            && validOffsets(result.curves.offsets.data(), header.numCurveOffsets, header.numCurveVertices)
+            && validOffsets(result.splines.offsets.data(), header.numSplineOffsets, header.numSplinePoints)
+            && validMesh(result.voronoiMesh, numPixels);
+
+    //  Los colores de la malla son los píxeles: si no coinciden es una colisión del hash.
+    for(int y = 0; ok && y < height; ++y)
+    {
+        const uint32_t* row = (const uint32_t*)((const unsigned char*)pixels + (size_t)y * stride);
+
+        ok = memcmp(row, result.voronoiMesh.faceColors + y * width, width * sizeof(uint32_t)) == 0;
+    }
+
+    if(!ok)
+    {
+        freeDepixelResult(result);
+    }
+
+    return ok;
+}
+
+static bool saveEntry(const std::string& fileName, uint64_t key, const DepixelResult& result)
+{
+    unsigned int numPixels = result.width * result.height;
+    unsigned int numCellVertices = result.voronoiGraph.offsets[numPixels];
+    uint64_t numMeshWords = (uint64_t)numCellVertices * 4 + numPixels + ((uint64_t)numCellVertices + 3) / 4;
+    CacheEntryHeader header;
+
+    //  Una malla que no cabe en los contadores de la cabecera no se guarda.
+    if(numMeshWords > UINT32_MAX)
+    {
+        return false;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEPIXEL_CACHE_MAGIC, sizeof(header.magic));
+    header.version = DEPIXEL_CACHE_VERSION;
+    header.width = result.width;
+    header.height = result.height;
+    header.numCellVertices = numCellVertices;
+    header.numMeshWords = numMeshWords;
+    header.numCurveVertices = result.curves.vertices.size();
+    header.numCurveOffsets = result.curves.offsets.size();
+    header.numSplinePoints = result.splines.x.size();
+    header.numSplineOffsets = result.splines.offsets.size();
+    header.numSplines = result.splines.closed.size();
+    header.key = key;
+
+    FILE* file = fopen(fileName.c_str(), "wb");
+
+    if(!file)
+    {
+        return false;
+    }
+
+    bool ok = writeArray(file, &header, sizeof(header))
+           && writeArray(file, result.similarityGraph, numPixels)
+           && writeArray(file, result.voronoiGraph.offsets, (numPixels + 1) * sizeof(unsigned int))
+           && writeArray(file, result.voronoiGraph.vertices, numCellVertices * 2)
+           && writeArray(file, result.voronoiMesh.origins, header.numMeshWords * sizeof(uint32_t))
+           && writeArray(file, result.curves.vertices.data(), header.numCurveVertices * sizeof(Point))
+           && writeArray(file, result.curves.offsets.data(), header.numCurveOffsets * sizeof(unsigned int))
+           && writeArray(file, result.splines.x.data(), header.numSplinePoints * sizeof(float))
+           && writeArray(file, result.splines.y.data(), header.numSplinePoints * sizeof(float))
+           && writeArray(file, result.splines.flags.data(), header.numSplinePoints)
+           && writeArray(file, result.splines.offsets.data(), header.numSplineOffsets * sizeof(unsigned int))
+           && writeArray(file, result.splines.closed.data(), header.numSplines);
+
+    return (fclose(file) == 0) && ok;
+}
+
+//  Marca key como la más reciente, dentro del lock.
+static void touchEntry(DepixelCache* cache, uint64_t key, unsigned long long size)
+{
+    std::map<uint64_t, CacheEntry>::iterator it = cache->entries.find(key);
+
+    if(it != cache->entries.end())
+    {
+        cache->recency.erase(it->second.recency);
+        cache->bytes -= it->second.size;
+    }
+    else
+    {
+        it = cache->entries.insert(std::make_pair(key, CacheEntry())).first;
+    }
+
+    cache->recency.push_front(key);
+    it->second.recency = cache->recency.begin();
+    it->second.size = size;
+    cache->bytes += size;
+}
+
+//  Borra las entradas menos usadas hasta quedar por debajo de maxBytes, dentro del lock. La más reciente no se borra
+// aunque sola ya pase del límite.
+static void evictEntries(DepixelCache* cache)
+{
+    std::error_code error;
+
+    while(cache->bytes > cache->maxBytes && cache->recency.size() > 1)
+    {
+        uint64_t key = cache->recency.back();
+        std::map<uint64_t, CacheEntry>::iterator it = cache->entries.find(key);
+
+        std::filesystem::remove(entryName(cache, key), error);
+        cache->bytes -= it->second.size;
+        cache->recency.pop_back();
+        cache->entries.erase(it);
+        ++cache->evictions;
+    }
+}
+
+//  Como depixel, pero buscando antes el resultado en la caché. Si no está, se calcula y se guarda.
+bool depixelCached(DepixelCache* cache, const uint32_t* pixels, int width, int height, int stride, DepixelResult& result,
+                   unsigned int numThreads, const DepixelSplineOptions& splineOptions)
+{
+    if(!cache || !pixels || width <= 0 || height <= 0 || stride < (int)(width * sizeof(uint32_t)))
+    {
+        return depixel(pixels, width, height, stride, result, numThreads, splineOptions);
+    }
+
+    uint64_t key = cacheKey(pixels, width, height, stride, splineOptions);
+    std::string fileName = entryName(cache, key);
+    std::error_code error;
+    bool known;
+
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+        known = cache->entries.count(key) > 0;
+    }
+
+    result.width = width;
+    result.height = height;
+    result.fromSnapshot = false;
+    result.curves.clear();
+    result.splines.clear();
+
+    if(known && loadEntry(fileName, key, pixels, width, height, stride, result))
+    {
+        std::lock_guard<std::mutex> guard(cache->lock);
+
+        std::filesystem::last_write_time(fileName, std::filesystem::file_time_type::clock::now(), error);
+        if(cache->entries.count(key) > 0)
+        {
+            touchEntry(cache, key, cache->entries[key].size);
+        }
+
+        ++cache->hits;
+
+        DEPIXEL_COUNT(DEPIXEL_COUNTER_IMAGES, 1);
+        DEPIXEL_COUNT(DEPIXEL_COUNTER_PIXELS, (unsigned long long)width * height);
+
+        return true;
+    }
+
+    ++cache->misses;
+
+    if(!depixel(pixels, width, height, stride, result, numThreads, splineOptions))
+    {
+        return false;
+    }
+
+    std::string temporaryName = fileName + "." + std::to_string(getpid()) + "."
+                                + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+    if(saveEntry(temporaryName, key, result))
+    {
+        std::filesystem::rename(temporaryName, fileName, error);
+    }
+    else
+    {
+        error = std::make_error_code(std::errc::io_error);
+    }
+
+    if(error)
+    {
+        std::filesystem::remove(temporaryName, error);
+        return true;
+    }
+
+    std::lock_guard<std::mutex> guard(cache->lock);
+
+    touchEntry(cache, key, std::filesystem::file_size(fileName, error));
+    evictEntries(cache);
+
+    return true;
+}
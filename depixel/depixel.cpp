@@ -0,0 +1,397 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <atomic>
+
+#include "depixel.h"
+#include "trace.h"
+
+unsigned char valencePattern[256];
+
+static std::atomic<unsigned long long> depixelCounters[DEPIXEL_COUNTER_COUNT];
+
+void depixelCounterAdd(DepixelCounter counter, unsigned long long value)
+{
+    depixelCounters[counter] += value;
+}
+
+bool depixelCountersEnabled(void)
+{
+    return DEPIXEL_COUNTERS != 0;
+}
+
+unsigned long long depixelCounterValue(DepixelCounter counter)
+{
+    return depixelCounters[counter];
+}
+
+const char* depixelCounterName(DepixelCounter counter)
+{
+    switch(counter)
+    {
+        case DEPIXEL_COUNTER_IMAGES:
+            return "images";
+        case DEPIXEL_COUNTER_PIXELS:
+            return "pixels";
+        case DEPIXEL_COUNTER_FULLY_CONNECTED_BLOCKS:
+            return "fully connected blocks";
+        case DEPIXEL_COUNTER_CROSSES:
+            return "crosses";
+        case DEPIXEL_COUNTER_CROSSES_REMOVED_DIAGONAL_1:
+            return "crosses removing diagonal 1";
+        case DEPIXEL_COUNTER_CROSSES_REMOVED_DIAGONAL_2:
+            return "crosses removing diagonal 2";
+        case DEPIXEL_COUNTER_CROSSES_REMOVED_BOTH:
+            return "crosses removing both diagonals";
+        case DEPIXEL_COUNTER_VALENCE_CHAINS:
+            return "valence 2 chains";
+        case DEPIXEL_COUNTER_VISIBLE_EDGES:
+            return "visible edges";
+        case DEPIXEL_COUNTER_CURVES:
+            return "curves";
+        case DEPIXEL_COUNTER_SPLINES:
+            return "splines";
+        case DEPIXEL_COUNTER_SPLINE_CORNERS:
+            return "spline corners";
+        default:
+            return "";
+    }
+}
+
+void resetDepixelCounters(void)
+{
+    for(int i = 0; i < DEPIXEL_COUNTER_COUNT; ++i)
+    {
+        depixelCounters[i] = 0;
+    }
+}
+
+void dumpTable(unsigned int* table, int width, int height)
+{
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            std::cout << std::hex << *table++ << "; ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void dumpTable(uint8_t* table, int width, int height)
+{
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            std::cout << std::hex << (unsigned int)(*table++) << "; ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void initAlgorithm(void)
+{
+    loadValencePattern();
+    selectSimilarityKernel(SIMILARITY_KERNEL_AUTO);
+}
+
+void loadValencePattern(void)
+{
+    unsigned int aux;
+    unsigned int valence;
+    unsigned int bit;
+    for(unsigned int pattern = 0; pattern < 256; ++pattern)
+    {
+        aux = pattern;
+        valence = 0;
+        for(bit = 0; bit < 8; ++bit)
+        {
+            if(aux & 1) ++valence;
+            aux >>= 1;
+        }
+
+        valencePattern[pattern] = valence;
+    }
+}
+
+unsigned int rgb2yuv(unsigned int rgb)
+{
+    unsigned int y, u, v, r, g, b;
+
+    r = ((rgb & 0xFF0000) >> 16);
+    g = ((rgb & 0xFF00) >> 8);
+    b = rgb & 0xFF;
+
+    y = (0.257 * r) + (0.504 * g) + (0.098 * b) + 16;
+    u = -(0.148 * r) - (0.291 * g) + (0.439 * b) + 128;
+    v = (0.439 * r) - (0.368 * g) - (0.071 * b) + 128;
+
+    return (y << 16) | (u << 8) | v;
+}
+
+unsigned int yuv2rgb(unsigned int yuv)
+{
+    unsigned int y, u, v, r, g, b;
+
+    y = ((yuv & 0xFF0000) >> 16);
+    u = ((yuv & 0xFF00) >> 8);
+    v = yuv & 0xFF;
+
+    r = 1.164 * (y - 16) + 1.596 * (v - 128);
+    g = 1.164 * (y - 16) - 0.813 * (v - 128) - 0.391 * (u - 128);
+    b = 1.164 * (y - 16) + 2.018 * (u - 128);
+
+    return (r << 16) | (g << 8) | b;
+}
+
+
+//  Convierte a YUV un buffer de píxeles 0xAARRGGBB. El stride va en bytes, así que vale tanto para buffers
+// compactos (stride = width * 4) como para el campo pitch de una superficie SDL.
+unsigned int* rgba2yuv(const uint32_t* pixels, int width, int height, int stride)
+{
+    unsigned int* buffer = new unsigned int[width * height];
+    unsigned int index = 0;
+
+    for(int y = 0; y < height; ++y)
+    {
+        const uint32_t* img = (const uint32_t*)((const unsigned char*)pixels + y * stride);
+
+        for(int x = 0; x < width; ++x)
+        {
+            buffer[index++] = rgb2yuv(*img++);
+        }
+    }
+
+    return buffer;
+}
+unsigned int* yuv2indexRGB(unsigned int* myYuvSurface, int width, int height, PaletteIndex& paletteRGB)
+{
+    unsigned int* buffer = new unsigned int[width * height];
+
+    unsigned int index = 0;
+
+    unsigned int yuvColorSurface;
+    unsigned int yuvColorPalette;
+    unsigned int ys, us, vs, yp, up, vp;
+    unsigned int colorIndex = 0;
+    unsigned int closest;
+    unsigned int prox;
+
+
+
+    PaletteIndex paletteYUV;
+
+    for(PaletteIndex::iterator it = paletteRGB.begin(); it != paletteRGB.end(); ++it)
+    {
+        paletteYUV[rgb2yuv(it->first)] = it->second;
+    }
+
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            yuvColorSurface = *myYuvSurface++;
+            ys = yuvColorSurface >> 16;
+            us = (yuvColorSurface >> 8) & 0xFF;
+            vs = yuvColorSurface & 0xFF;
+
+            closest = 0xFFFFFFFF;
+
+            for(PaletteIndex::iterator it =  paletteYUV.begin(); it != paletteYUV.end(); ++it)
+            {
+                yuvColorPalette = it->first;
+
+                yp = yuvColorPalette >> 16;
+                up = (yuvColorPalette >> 8) & 0xFF;
+                vp = yuvColorPalette & 0xFF;
+
+                prox = ((yp - ys) * (yp - ys)) + ((up - us) * (up - us)) + ((vp - vs) * (vp - vs));
+
+                if(prox < closest)
+                {
+                    closest = prox;
+                    colorIndex = it->second;
+                }
+            }
+
+            //std::cout << std::setw(2) << std::setfill('0') << colorIndex << "; ";
+            buffer[index++] = colorIndex;
+        }
+    }
+
+    if(DEPIXEL_TRACE_ENABLED(DEPIXEL_TRACE_TABLES))
+    {
+        std::cout << "================================================================" << std::endl;
+        std::cout << "Index Table" << std::endl;
+        std::cout << "================================================================" << std::endl;
+        dumpTable(buffer, width, height);
+        std::cout << "================================================================" << std::endl;
+    }
+
+    return buffer;
+}
+
+//  Etapas que van detrás del diagrama de Voronoi: su malla de semisegmentos, curvas y splines.
+static void depixelCurves(const uint32_t* pixels, int stride, DepixelResult& result, unsigned int numThreads,
+                          const DepixelSplineOptions& splineOptions)
+{
+    result.voronoiMesh = buildVoronoiMesh(result.voronoiGraph, pixels, stride);
+    result.curves = extractCurves(result.voronoiMesh);
+    result.splines = fitSplines(result.curves, numThreads);
+    optimizeSplines(result.splines, splineOptions.maxIterations, splineOptions.tolerance, numThreads);
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_IMAGES, 1);
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_PIXELS, (unsigned long long)result.width * result.height);
+}
+
+static void clearDepixelResult(DepixelResult& result, int width, int height)
+{
+    result.width = width;
+    result.height = height;
+    result.fromSnapshot = false;
+    result.similarityGraph = 0;
+    result.voronoiGraph.offsets = 0;
+    result.voronoiGraph.vertices = 0;
+    result.voronoiMesh.origins = 0;
+    result.curves.clear();
+    result.splines.clear();
+}
+
+//  Ejecuta el pipeline completo sobre una imagen: grafo de similitud, simplificación, diagrama de Voronoi, su malla
+// de semisegmentos, curvas y splines.
+// Con numThreads distinto de 1 las etapas que lo admiten se reparten entre varios hilos (0 = uno por núcleo); para
+// lotes de imágenes pequeñas suele ser mejor dejarlo en 1 y paralelizar por imagen.
+bool depixel(const uint32_t* pixels, int width, int height, int stride, DepixelResult& result, unsigned int numThreads,
+             const DepixelSplineOptions& splineOptions)
+{
+    clearDepixelResult(result, width, height);
+
+    if(!pixels || width <= 0 || height <= 0 || stride < (int)(width * sizeof(uint32_t)))
+    {
+        return false;
+    }
+
+    unsigned int* yuvSurface = rgba2yuv(pixels, width, height, stride);
+    //  Grafo de similitud y simplificación de los bloques totalmente conectados en una sola pasada.
+    if(numThreads == 1)
+    {
+        result.similarityGraph = hqxGetSimplifiedSimilarityGraph(yuvSurface, width, height);
+    }
+    else
+    {
+        result.similarityGraph = hqxGetSimplifiedSimilarityGraphParallel(yuvSurface, width, height, numThreads);
+    }
+    delete [] yuvSurface;
+
+    simplifyCrossesSimilarityGraph(result.similarityGraph, width, height);
+
+    result.voronoiGraph = extractVoronoiGraph(result.similarityGraph, width, height);
+    depixelCurves(pixels, stride, result, numThreads, splineOptions);
+
+    return true;
+}
+
+//  Como depixel, pero con el grafo de similitud y las celdas calculados por tiles de tileSize x tileSize y sólo una vez
+// por tile distinto (ver hqxGetSimplifiedSimilarityGraphTiled y extractVoronoiGraphTiled), para sprite sheets y mapas
+// de tiles. Los cruces se resuelven sobre la imagen completa, porque la heurística de las curvas sigue cadenas de
+// cualquier longitud. El resultado es el mismo que con depixel; en stats se devuelve cuántos tiles se han calculado.
+bool depixelTiled(const uint32_t* pixels, int width, int height, int stride, int tileSize, DepixelResult& result,
+                  DepixelTileStats& stats, unsigned int numThreads, const DepixelSplineOptions& splineOptions)
+{
+    clearDepixelResult(result, width, height);
+
+    stats.tiles = 0;
+    stats.uniqueSimilarityTiles = 0;
+    stats.uniqueCellTiles = 0;
+
+    if(!pixels || width <= 0 || height <= 0 || stride < (int)(width * sizeof(uint32_t)) || tileSize <= 0)
+    {
+        return false;
+    }
+
+    stats.tiles = ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize);
+
+    unsigned int* yuvSurface = rgba2yuv(pixels, width, height, stride);
+    result.similarityGraph = hqxGetSimplifiedSimilarityGraphTiled(yuvSurface, width, height, tileSize,
+                                                                  stats.uniqueSimilarityTiles);
+    delete [] yuvSurface;
+
+    simplifyCrossesSimilarityGraph(result.similarityGraph, width, height);
+
+    result.voronoiGraph = extractVoronoiGraphTiled(result.similarityGraph, width, height, tileSize, stats.uniqueCellTiles);
+    depixelCurves(pixels, stride, result, numThreads, splineOptions);
+
+    return true;
+}
+
+//  Como depixel, pero retomando el pipeline desde un snapshot: el grafo de similitud y las celdas no se calculan, se
+// usan los del snapshot, que tiene que seguir cargado mientras se use result.
+bool depixelFromSnapshot(const DepixelSnapshot& snapshot, DepixelResult& result, unsigned int numThreads,
+                         const DepixelSplineOptions& splineOptions)
+{
+    clearDepixelResult(result, snapshot.width, snapshot.height);
+
+    if(!snapshot.data)
+    {
+        return false;
+    }
+
+    result.fromSnapshot = true;
+    result.similarityGraph = snapshot.similarityGraph;
+    result.voronoiGraph = snapshot.voronoiGraph;
+    depixelCurves(snapshot.pixels, snapshot.width * sizeof(uint32_t), result, numThreads, splineOptions);
+
+    return true;
+}
+
+void freeDepixelResult(DepixelResult& result)
+{
+    freeVoronoiMesh(result.voronoiMesh);
+
+    if(!result.fromSnapshot)
+    {
+        freeVoronoiGraph(result.voronoiGraph);
+        delete [] result.similarityGraph;
+    }
+
+    result.similarityGraph = 0;
+    result.voronoiGraph.offsets = 0;
+    result.voronoiGraph.vertices = 0;
+    result.fromSnapshot = false;
+    result.curves.clear();
+    result.splines.clear();
+}
+
+//  Guarda las curvas en texto: una cabecera con el tamaño de la imagen y después una curva por línea, con su número
+// de vértices seguido de los vértices (coordenadas del diagrama de Voronoi, 4 unidades por píxel).
+bool saveCurves(const char* fileName, const DepixelResult& result)
+{
+    FILE* file = fopen(fileName, "w");
+
+    if(!file)
+    {
+        return false;
+    }
+
+    fprintf(file, "# depixel curves %d %d %u\n", result.width, result.height, result.curves.size());
+
+    for(unsigned int i = 0; i < result.curves.size(); ++i)
+    {
+        const Point* curve = result.curves.curve(i);
+        unsigned int numVertices = result.curves.curveSize(i);
+
+        fprintf(file, "%u", numVertices);
+
+        for(unsigned int v = 0; v < numVertices; ++v)
+        {
+            fprintf(file, " %d,%d", curve[v].first, curve[v].second);
+        }
+
+        fprintf(file, "\n");
+    }
+
+    bool ok = !ferror(file);
+
+    return (fclose(file) == 0) && ok;
+}
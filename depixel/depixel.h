@@ -0,0 +1,405 @@
+/*
+ * libdepixel: núcleo del algoritmo Kopf-Lischinski, independiente de SDL.
+ *
+ * Todas las etapas trabajan sobre un buffer de píxeles de 32 bits (0xAARRGGBB, el mismo formato que usan las
+ * superficies SDL de 32 bpp y la librería hqx), con su ancho, alto y stride (bytes por fila).
+ */
+
+#ifndef __DEPIXEL_H_
+#define __DEPIXEL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <utility>
+#include <map>
+#include <list>
+#include <set>
+#include <vector>
+
+typedef std::map<unsigned int, unsigned int> PaletteIndex;
+typedef std::pair<int, int> Point;
+typedef std::list<Point> Polygon;
+
+typedef std::pair<Point, Point> Edge;
+
+//  Celda de Voronoi de un píxel: sus vértices en el orden del contorno, relativos al origen del píxel (x << 2, y << 2).
+// Es sólo una vista sobre los datos del VoronoiGraph.
+struct VoronoiCell
+{
+    const int8_t* vertices;     //  (x, y) de cada vértice, entre -1 y 5.
+    unsigned int size;
+
+    Point vertex(unsigned int i) const
+    {
+        return Point(vertices[i * 2], vertices[(i * 2) + 1]);
+    }
+};
+
+//  Diagrama de Voronoi de la imagen, con todas las celdas en una sola reserva: la celda del píxel i son los vértices
+// [offsets[i], offsets[i + 1]) de vertices. Se libera con freeVoronoiGraph.
+struct VoronoiGraph
+{
+    int width;
+    int height;
+    unsigned int* offsets;
+    int8_t* vertices;
+
+    VoronoiCell cell(int x, int y) const
+    {
+        unsigned int i = x + y * width;
+        VoronoiCell voronoiCell = {vertices + (offsets[i] * 2), offsets[i + 1] - offsets[i]};
+
+        return voronoiCell;
+    }
+};
+
+//  Todos los vértices de las celdas caen en la rejilla de la imagen: o son esquinas de píxel (x << 2, y << 2), o son
+// uno de los 4 puntos interiores de un píxel ((x << 2) + 1 o 3, (y << 2) + 1 o 3). Cada esquina (width + 1 por
+// height + 1) tiene así 5 huecos: el 0 para ella misma y del 1 al 4 para los puntos interiores del píxel que empieza en
+// ella, en el orden del contorno. El id de un vértice es su hueco.
+#define VORONOI_VERTEX_SLOTS 5
+
+//  Twin de los semisegmentos del borde de la imagen.
+#define VORONOI_NO_TWIN 0xFFFFFFFFu
+
+//  Malla de semisegmentos (DCEL) del diagrama de Voronoi, construida una vez por imagen para todas las etapas que
+// trabajan con sus segmentos. Cada celda aporta un semisegmento por lado, en el orden del contorno, así que los de la
+// celda del píxel i son [offsets[i], offsets[i + 1]) del VoronoiGraph del que sale. Los arrays van en una sola reserva,
+// y los de la malla de un DepixelEditor pueden tener sitio libre detrás. Se libera con freeVoronoiMesh.
+struct VoronoiMesh
+{
+    int width;
+    int height;
+    unsigned int numVertices;   //  Tamaño del espacio de ids de vértice.
+    unsigned int numHalfEdges;
+    uint32_t* origins;          //  Vértice donde empieza cada semisegmento (acaba en el origen de su next).
+    uint32_t* twins;            //  El mismo segmento en la celda vecina, o VORONOI_NO_TWIN.
+    uint32_t* nexts;            //  El siguiente en el contorno de su celda.
+    uint32_t* faces;            //  Píxel (x + y * width) de su celda.
+    uint32_t* faceColors;       //  Color de cada píxel.
+    uint8_t* visible;           //  Separa píxeles de distinto color o está en el borde de la imagen.
+
+    Point vertex(uint32_t id) const
+    {
+        static const int8_t slotOffsets[VORONOI_VERTEX_SLOTS][2] = {{0, 0}, {1, 1}, {3, 1}, {3, 3}, {1, 3}};
+        uint32_t corner = id / VORONOI_VERTEX_SLOTS;
+        uint32_t slot = id % VORONOI_VERTEX_SLOTS;
+
+        return Point(((corner % (width + 1)) << 2) + slotOffsets[slot][0],
+                     ((corner / (width + 1)) << 2) + slotOffsets[slot][1]);
+    }
+};
+
+//  Curvas de la imagen en un solo buffer de vértices: la curva i son los vértices [offsets[i], offsets[i + 1]). Las
+// curvas cerradas repiten al final su primer vértice.
+struct CurveList
+{
+    std::vector<Point> vertices;
+    std::vector<unsigned int> offsets;
+
+    unsigned int size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    unsigned int curveSize(unsigned int i) const
+    {
+        return offsets[i + 1] - offsets[i];
+    }
+
+    const Point* curve(unsigned int i) const
+    {
+        return &vertices[offsets[i]];
+    }
+
+    void clear()
+    {
+        vertices.clear();
+        offsets.clear();
+    }
+};
+
+//  Fin de las listas de CurveIndex.
+#define CURVE_INDEX_END 0xFFFFFFFFu
+
+struct CurveIndexEntry
+{
+    unsigned int curve;
+    uint32_t next;
+};
+
+//  Curvas de un CurveList por cada vértice por el que pasan (por su id, como en VoronoiMesh), para que updateCurves
+// encuentre las que tiene que rehacer sin recorrerlas todas: las del vértice v son las de la lista que empieza en
+// entries[first[v]] y sigue por next. Se construye con buildCurveIndex.
+struct CurveIndex
+{
+    std::vector<uint32_t> first;
+    std::vector<CurveIndexEntry> entries;
+    uint32_t freeEntries;               //  Primera entrada libre; las demás siguen por next.
+};
+
+//  Marcas de los puntos de control de las splines.
+#define SPLINE_POINT_END        0x01    //  Extremo de una spline abierta (repetido, para que la curva pase por él).
+#define SPLINE_POINT_CORNER     0x02    //  Esquina (repetida, para que la curva no la suavice).
+
+//  B-splines cuadráticos uniformes que suavizan las curvas, con los puntos de control en arrays planos: los de la
+// spline i son [offsets[i], offsets[i + 1]) de x, y y flags, en coordenadas del diagrama (4 unidades por píxel). En
+// las cerradas (closed[i]) el último punto de control enlaza con el primero.
+struct SplineList
+{
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<uint8_t> flags;
+    std::vector<unsigned int> offsets;
+    std::vector<uint8_t> closed;
+
+    unsigned int size() const
+    {
+        return offsets.empty() ? 0 : offsets.size() - 1;
+    }
+
+    unsigned int splineSize(unsigned int i) const
+    {
+        return offsets[i + 1] - offsets[i];
+    }
+
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        flags.clear();
+        offsets.clear();
+        closed.clear();
+    }
+};
+
+//  Bloques 2x2 con las dos diagonales conectadas, indexados por su píxel superior izquierdo (x + y * width).
+typedef std::vector<unsigned int> CrossList;
+
+extern unsigned char valencePattern[256];
+
+//  Kernels del grafo de similitud (simd.cpp). initAlgorithm elige el mejor que soporte la CPU.
+enum SimilarityKernel
+{
+    SIMILARITY_KERNEL_AUTO,
+    SIMILARITY_KERNEL_SCALAR,
+    SIMILARITY_KERNEL_SSE2,
+    SIMILARITY_KERNEL_AVX2
+};
+
+//  Calcula los patrones de los píxeles interiores [xBegin, xEnd) de una fila (1 <= xBegin, xEnd <= width - 1).
+typedef void (*SimilarityRowFunction)(const unsigned int* prevRow, const unsigned int* row, const unsigned int* nextRow,
+                                      uint8_t* out, int xBegin, int xEnd);
+
+extern SimilarityRowFunction similarityRowKernel;
+
+//  Un paso de la optimización de las splines sobre los puntos [begin, end) de los arrays de trabajo de optimizeSplines
+// (con dos puntos válidos a cada lado). Devuelve el mayor desplazamiento al cuadrado. Se elige con el kernel de
+// similitud.
+typedef float (*SplineStepFunction)(const float* x, const float* y, const float* x0, const float* y0, const float* movable,
+                                    float* outX, float* outY, int begin, int end, float step, float positionWeight);
+
+extern SplineStepFunction splineStepKernel;
+
+//  Resultado completo del pipeline para una imagen. Se libera con freeDepixelResult.
+struct DepixelResult
+{
+    int width;
+    int height;
+    bool fromSnapshot;          //  El grafo de similitud y las celdas son de un DepixelSnapshot, que los libera.
+    uint8_t* similarityGraph;
+    VoronoiGraph voronoiGraph;
+    VoronoiMesh voronoiMesh;
+    CurveList curves;
+    SplineList splines;
+};
+
+//  Contadores por etapa, acumulados entre todas las llamadas (y todos los hilos) desde el último resetDepixelCounters.
+// Sólo cuentan si la librería se compila con -DDEPIXEL_COUNTERS=1 (ver trace.h); si no, siempre valen 0.
+enum DepixelCounter
+{
+    DEPIXEL_COUNTER_IMAGES,
+    DEPIXEL_COUNTER_PIXELS,
+    DEPIXEL_COUNTER_FULLY_CONNECTED_BLOCKS,
+    DEPIXEL_COUNTER_CROSSES,
+    DEPIXEL_COUNTER_CROSSES_REMOVED_DIAGONAL_1,
+    DEPIXEL_COUNTER_CROSSES_REMOVED_DIAGONAL_2,
+    DEPIXEL_COUNTER_CROSSES_REMOVED_BOTH,
+    DEPIXEL_COUNTER_VALENCE_CHAINS,
+    DEPIXEL_COUNTER_VISIBLE_EDGES,
+    DEPIXEL_COUNTER_CURVES,
+    DEPIXEL_COUNTER_SPLINES,
+    DEPIXEL_COUNTER_SPLINE_CORNERS,
+    DEPIXEL_COUNTER_COUNT
+};
+
+bool depixelCountersEnabled(void);
+unsigned long long depixelCounterValue(DepixelCounter counter);
+const char* depixelCounterName(DepixelCounter counter);
+void resetDepixelCounters(void);
+
+void dumpTable(unsigned int* table, int width, int height);
+void dumpTable(uint8_t* table, int width, int height);
+void initAlgorithm(void);
+void loadValencePattern(void);
+unsigned int rgb2yuv(unsigned int rgb);
+unsigned int yuv2rgb(unsigned int yuv);
+unsigned int* rgba2yuv(const uint32_t* pixels, int width, int height, int stride);
+unsigned int* yuv2indexRGB(unsigned int* myYuvSurface, int width, int height, PaletteIndex& paletteRGB);
+
+bool hqxDiff(unsigned int yuv1, unsigned int yuv2);
+unsigned int hqxGetPattern(const unsigned int* prevRow, const unsigned int* row, const unsigned int* nextRow, int x, int width);
+bool selectSimilarityKernel(SimilarityKernel kernel);
+const char* similarityKernelName(void);
+uint8_t* hqxGetSimilarityGraph(unsigned int* yuvSurface, int width, int height);
+uint8_t* hqxGetSimilarityGraphParallel(unsigned int* yuvSurface, int width, int height, unsigned int numThreads = 0);
+void simplifyFullyBlockSimilarityGraph(uint8_t* similarityGraph, int width, int height);
+uint8_t* hqxGetSimplifiedSimilarityGraph(unsigned int* yuvSurface, int width, int height);
+uint8_t* hqxGetSimplifiedSimilarityGraphParallel(unsigned int* yuvSurface, int width, int height, unsigned int numThreads = 0);
+uint8_t* hqxGetSimplifiedSimilarityGraphTiled(unsigned int* yuvSurface, int width, int height, int tileSize,
+                                              unsigned int& numUniqueTiles);
+void hqxUpdateSimplifiedSimilarityGraph(unsigned int* yuvSurface, uint8_t* similarityGraph, int width, int height,
+                                        int x0, int y0, int x1, int y1);
+void findCrossesInSimilarityGraph(uint8_t* similarityGraph, int width, int height, CrossList& crosses);
+void simplifyCrossesSimilarityGraph(uint8_t* similarityGraph, int width, int height);
+void findCrossCurveRows(uint8_t* similarityGraph, int width, int height, int y0, int y1, int& rowBegin, int& rowEnd);
+void findValenceChainBlocks(uint8_t* similarityGraph, int width, int height, int x0, int y0, int x1, int y1,
+                            CrossList& blocks);
+void simplifyCrossesInBlocks(uint8_t* similarityGraph, uint8_t* unresolvedGraph, int width, int height,
+                             const CrossList& blocks);
+//  Las heurísticas suman a weights[i * 2] (aspa 1) y weights[i * 2 + 1] (aspa 2) los pesos del cruce crosses[i].
+void getWeightCurvesFromCrossesInSimilarityGraph(unsigned* weights, uint8_t* similarityGraph, int width, int height,
+                                                 const CrossList& crosses);
+void getWeightSparsePixelsFromCrossesInSimilarityGraph(unsigned* weights, uint8_t* similarityGraph, int width, int height,
+                                                       const CrossList& crosses);
+void getWeightIslandsFromCrossesInSimilarityGraph(unsigned* weights, uint8_t* similarityGraph, int width,
+                                                  const CrossList& crosses);
+
+VoronoiGraph extractVoronoiGraph(uint8_t* similarityGraph, int width, int height);
+VoronoiGraph extractVoronoiGraphTiled(uint8_t* similarityGraph, int width, int height, int tileSize,
+                                     unsigned int& numUniqueTiles);
+void updateVoronoiGraph(VoronoiGraph& voronoiGraph, uint8_t* similarityGraph, const std::vector<unsigned int>& cells,
+                        std::vector<unsigned int>& previousSizes);
+void freeVoronoiGraph(VoronoiGraph& voronoiGraph);
+
+VoronoiMesh buildVoronoiMesh(const VoronoiGraph& voronoiGraph, const uint32_t* pixels, int stride,
+                             unsigned int spareHalfEdges = 0);
+void freeVoronoiMesh(VoronoiMesh& voronoiMesh);
+void updateVoronoiMesh(VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph,
+                       const std::vector<unsigned int>& previousSizes, const uint32_t* pixels, int stride,
+                       std::vector<unsigned int>& cells);
+
+std::set<Edge> extractSpLines(const VoronoiMesh& voronoiMesh);
+std::set<Edge> extractVisibleEdges(const VoronoiMesh& voronoiMesh);
+CurveList extractCurves(const VoronoiMesh& voronoiMesh);
+CurveList extractCurves(const VoronoiMesh& voronoiMesh, int rowBegin, int rowEnd, std::vector<uint8_t>& seamEnds);
+void buildCurveIndex(CurveIndex& index, const CurveList& curves, const VoronoiMesh& voronoiMesh);
+void updateCurves(CurveList& curves, CurveIndex& index, const VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph,
+                  const std::vector<unsigned int>& cells, unsigned int& numRemoved, unsigned int& numAdded);
+
+SplineList fitSplines(const CurveList& curves, unsigned int numThreads = 1);
+//  Valores por defecto de la optimización de las splines de depixel (DepixelSplineOptions).
+#define DEPIXEL_SPLINE_ITERATIONS   32
+#define DEPIXEL_SPLINE_TOLERANCE    0.001f
+
+unsigned int optimizeSplines(SplineList& splines, unsigned int maxIterations, float tolerance, unsigned int numThreads = 1);
+
+//  Optimización de las splines de depixel: iteraciones máximas (con 0 no se optimiza) y desplazamiento (en unidades del
+// diagrama) por debajo del cual se para. Va con cada llamada, así que cada una puede usar la suya.
+struct DepixelSplineOptions
+{
+    unsigned int maxIterations = DEPIXEL_SPLINE_ITERATIONS;
+    float tolerance = DEPIXEL_SPLINE_TOLERANCE;
+};
+
+//  Grafo de similitud y celdas de una imagen guardados con saveSnapshot (snapshot.cpp) y cargados con mmap: los
+// punteros apuntan al fichero proyectado. Se libera con freeSnapshot.
+struct DepixelSnapshot
+{
+    int width;
+    int height;
+    const uint32_t* pixels;     //  Sin relleno entre filas (stride = width * 4).
+    uint8_t* similarityGraph;
+    VoronoiGraph voronoiGraph;
+    void* data;
+    size_t size;
+};
+
+bool depixel(const uint32_t* pixels, int width, int height, int stride, DepixelResult& result, unsigned int numThreads = 1,
+             const DepixelSplineOptions& splineOptions = DepixelSplineOptions());
+bool depixelFromSnapshot(const DepixelSnapshot& snapshot, DepixelResult& result, unsigned int numThreads = 1,
+                         const DepixelSplineOptions& splineOptions = DepixelSplineOptions());
+
+//  Tiles calculados por depixelTiled: en total, y distintos en el grafo de similitud y en las celdas.
+struct DepixelTileStats
+{
+    unsigned int tiles;
+    unsigned int uniqueSimilarityTiles;
+    unsigned int uniqueCellTiles;
+};
+
+bool depixelTiled(const uint32_t* pixels, int width, int height, int stride, int tileSize, DepixelResult& result,
+                  DepixelTileStats& stats, unsigned int numThreads = 1,
+                  const DepixelSplineOptions& splineOptions = DepixelSplineOptions());
+void freeDepixelResult(DepixelResult& result);
+bool saveCurves(const char* fileName, const DepixelResult& result);
+
+//  Caché en disco de resultados por contenido (cache.cpp), compartible entre hilos.
+struct DepixelCache;
+
+struct DepixelCacheStats
+{
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long evictions;
+    unsigned long long entries;
+    unsigned long long bytes;
+};
+
+DepixelCache* openDepixelCache(const char* directory, unsigned long long maxBytes);
+void closeDepixelCache(DepixelCache* cache);
+DepixelCacheStats depixelCacheStats(const DepixelCache* cache);
+bool depixelCached(DepixelCache* cache, const uint32_t* pixels, int width, int height, int stride, DepixelResult& result,
+                   unsigned int numThreads = 1, const DepixelSplineOptions& splineOptions = DepixelSplineOptions());
+
+//  Edición incremental de una imagen (incremental.cpp): cada cambio rehace sólo lo que depende de los píxeles cambiados.
+struct DepixelEditor;
+
+struct DepixelUpdateStats
+{
+    unsigned int pixels;            //  Píxeles con el grafo de similitud rehecho.
+    unsigned int blocks;            //  Bloques 2x2 revisados al resolver los cruces.
+    unsigned int cells;             //  Celdas rehechas en la malla.
+    unsigned int curvesRemoved;
+    unsigned int curvesAdded;
+};
+
+DepixelEditor* openDepixelEditor(const uint32_t* pixels, int width, int height, int stride, unsigned int numThreads = 1);
+void closeDepixelEditor(DepixelEditor* editor);
+const DepixelResult& depixelEditorResult(const DepixelEditor* editor);
+bool updateDepixelEditor(DepixelEditor* editor, const uint32_t* pixels, int stride, int x0, int y0, int x1, int y1,
+                         DepixelUpdateStats& stats);
+
+bool saveSnapshot(const char* fileName, const uint32_t* pixels, int stride, const DepixelResult& result);
+bool loadSnapshot(const char* fileName, DepixelSnapshot& snapshot);
+void freeSnapshot(DepixelSnapshot& snapshot);
+
+//  Bitmap escalado del resultado (raster.cpp), por tiles en paralelo con antialiasing por cobertura.
+uint32_t* rasterizeCells(const DepixelResult& result, float scale, int& outWidth, int& outHeight, unsigned int numThreads = 0);
+
+//  Capas de saveSvg (svg.cpp).
+#define SVG_LAYER_CELLS     0x01    //  Un <path> relleno por región de color.
+#define SVG_LAYER_CURVES    0x02    //  Las curvas, en un <path> sin relleno.
+
+bool saveSvg(const char* fileName, const DepixelResult& result, unsigned int layers = SVG_LAYER_CELLS | SVG_LAYER_CURVES);
+
+//  Pipeline por bandas (banded.cpp): las curvas se entregan una a una, en coordenadas de la imagen completa. Son las
+// mismas que con depixel; el contexto de una banda crece con las curvas largas que pasan por sus cruces.
+typedef void (*CurveCallback)(const Point* vertices, unsigned int numVertices, void* userData);
+
+bool depixelBanded(const uint32_t* pixels, int width, int height, int stride, int bandHeight,
+                   CurveCallback callback, void* userData);
+bool saveCurvesBanded(const char* fileName, const uint32_t* pixels, int width, int height, int stride, int bandHeight);
+
+#endif
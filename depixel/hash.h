@@ -0,0 +1,32 @@
+/*
+ * Hash rápido de 64 bits para libdepixel (caché de resultados, tiles repetidos). No es criptográfico: quien lo use
+ * tiene que comparar los datos antes de fiarse de una coincidencia.
+ */
+
+#ifndef __DEPIXEL_HASH_H_
+#define __DEPIXEL_HASH_H_
+
+#include <stdint.h>
+
+//  Mezcla una palabra de 64 bits en hash.
+inline uint64_t hashWord(uint64_t hash, uint64_t value)
+{
+    hash ^= value * 0x87C37B91114253D5ull;
+    hash = ((hash << 31) | (hash >> 33)) * 0x4CF5AD432745937Full;
+
+    return hash;
+}
+
+//  Mezcla final, para que todos los bits del hash dependan de todos los de la entrada.
+inline uint64_t hashFinish(uint64_t hash)
+{
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+#endif
@@ -0,0 +1,262 @@
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "depixel.h"
+#include "trace.h"
+
+//  Edición incremental, para editores de sprites: el resultado de una imagen se mantiene entre cambio y cambio, y cada
+// cambio en un rectángulo rehace sólo lo que puede depender de él:
+//      yuv             los píxeles del rectángulo.
+//      grafo           el rectángulo con un píxel más alrededor: el patrón de un píxel depende de sus 8 vecinos, y
+//                      un bloque totalmente conectado sólo de sus 4 píxeles.
+//      cruces          los bloques a los que llega la ventana de 8x8 de la heurística de los píxeles dispersos (4
+//                      píxeles alrededor del grafo rehecho) y los que tocan una cadena de valencia 2 que pase junto a
+//                      él, en el grafo de antes o en el de después, que pueden estar lejos.
+//      celdas          las de los píxeles cuyo grafo ha cambiado y sus 4 vecinos.
+//      malla           esas celdas, las del rectángulo (por el color) y sus 8 vecinas.
+//      curvas          las que pasan por algún vértice de esas celdas, que se buscan en un índice por vértice.
+//  El grafo, la malla y las curvas se cambian en su sitio: sólo si alguna celda rehecha cambia de número de vértices
+// se desplazan las que van detrás y los índices que apuntan a ellas.
+//  Las splines no se mantienen: la optimización converge con todas las de la imagen a la vez, así que no se pueden
+// rehacer por partes. result.splines queda vacío; si hacen falta, fitSplines y optimizeSplines sobre result.curves.
+struct DepixelEditor
+{
+    unsigned int* yuvSurface;
+    uint8_t* unresolvedGraph;       //  El grafo de similitud antes de resolver los cruces.
+    CurveIndex curveIndex;          //  El de result.curves.
+    DepixelResult result;
+};
+
+//  Calcula el resultado inicial de la imagen (sin splines). Devuelve 0 si la imagen no es válida; se libera con
+// closeDepixelEditor.
+DepixelEditor* openDepixelEditor(const uint32_t* pixels, int width, int height, int stride, unsigned int numThreads)
+{
+    if(!pixels || width <= 0 || height <= 0 || stride < (int)(width * sizeof(uint32_t)))
+    {
+        return 0;
+    }
+
+    DepixelEditor* editor = new DepixelEditor;
+    DepixelResult& result = editor->result;
+    unsigned int numPixels = width * height;
+
+    editor->yuvSurface = rgba2yuv(pixels, width, height, stride);
+
+    if(numThreads == 1)
+    {
+        editor->unresolvedGraph = hqxGetSimplifiedSimilarityGraph(editor->yuvSurface, width, height);
+    }
+    else
+    {
+        editor->unresolvedGraph = hqxGetSimplifiedSimilarityGraphParallel(editor->yuvSurface, width, height, numThreads);
+    }
+
+    result.width = width;
+    result.height = height;
+    result.fromSnapshot = false;
+    result.similarityGraph = new uint8_t[numPixels];
+
+    memcpy(result.similarityGraph, editor->unresolvedGraph, numPixels);
+    simplifyCrossesSimilarityGraph(result.similarityGraph, width, height);
+
+    result.voronoiGraph = extractVoronoiGraph(result.similarityGraph, width, height);
+    //  Con sitio para que las celdas crezcan un 1/16 antes de tener que cambiar la reserva de la malla.
+    result.voronoiMesh = buildVoronoiMesh(result.voronoiGraph, pixels, stride, result.voronoiGraph.offsets[numPixels] / 16);
+    result.curves = extractCurves(result.voronoiMesh);
+
+    buildCurveIndex(editor->curveIndex, result.curves, result.voronoiMesh);
+
+    return editor;
+}
+
+void closeDepixelEditor(DepixelEditor* editor)
+{
+    if(!editor)
+    {
+        return;
+    }
+
+    freeDepixelResult(editor->result);
+
+    delete [] editor->yuvSurface;
+    delete [] editor->unresolvedGraph;
+    delete editor;
+}
+
+//  El resultado actual. Sigue siendo del editor: vale hasta el siguiente updateDepixelEditor o closeDepixelEditor.
+const DepixelResult& depixelEditorResult(const DepixelEditor* editor)
+{
+    return editor->result;
+}
+
+//  Actualiza el resultado después de cambiar los píxeles [x0, x1) x [y0, y1) de la imagen. pixels es la imagen completa
+// ya cambiada (del mismo tamaño, con cualquier stride) y fuera del rectángulo tiene que ser igual que antes. El grafo,
+// las celdas y la malla quedan iguales que con depixel sobre la imagen nueva, y las curvas son las mismas, aunque no en
+// el mismo orden: las rehechas van al final de la lista.
+bool updateDepixelEditor(DepixelEditor* editor, const uint32_t* pixels, int stride, int x0, int y0, int x1, int y1,
+                         DepixelUpdateStats& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    if(!editor || !pixels || stride < (int)(editor->result.width * sizeof(uint32_t)))
+    {
+        return false;
+    }
+
+    DepixelResult& result = editor->result;
+    int width = result.width;
+    int height = result.height;
+    int x, y;
+
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    x1 = std::min(width, x1);
+    y1 = std::min(height, y1);
+
+    if(x0 >= x1 || y0 >= y1)
+    {
+        return true;
+    }
+
+    for(y = y0; y < y1; ++y)
+    {
+        const uint32_t* img = (const uint32_t*)((const unsigned char*)pixels + y * stride);
+
+        for(x = x0; x < x1; ++x)
+        {
+            editor->yuvSurface[x + y * width] = rgb2yuv(img[x]);
+        }
+    }
+
+    //  Grafo rehecho, y los píxeles cuyas cadenas de valencia 2 pueden cambiar (un píxel más: las cadenas que acaban
+    // junto al grafo rehecho pueden seguir ahora por él).
+    int gx0 = std::max(0, x0 - 1);
+    int gy0 = std::max(0, y0 - 1);
+    int gx1 = std::min(width, x1 + 1);
+    int gy1 = std::min(height, y1 + 1);
+    int chainX0 = std::max(0, gx0 - 1);
+    int chainY0 = std::max(0, gy0 - 1);
+    int chainX1 = std::min(width, gx1 + 1);
+    int chainY1 = std::min(height, gy1 + 1);
+
+    CrossList blocks;
+
+    findValenceChainBlocks(editor->unresolvedGraph, width, height, chainX0, chainY0, chainX1, chainY1, blocks);
+    hqxUpdateSimplifiedSimilarityGraph(editor->yuvSurface, editor->unresolvedGraph, width, height, gx0, gy0, gx1, gy1);
+    findValenceChainBlocks(editor->unresolvedGraph, width, height, chainX0, chainY0, chainX1, chainY1, blocks);
+
+    //  La ventana de los píxeles dispersos va de 3 píxeles antes a 4 después del píxel superior izquierdo del cruce.
+    for(y = std::max(0, gy0 - 4); y < std::min(height - 1, gy1 + 3); ++y)
+    {
+        for(x = std::max(0, gx0 - 4); x < std::min(width - 1, gx1 + 3); ++x)
+        {
+            blocks.push_back(x + y * width);
+        }
+    }
+
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+    //  Píxeles cuyo grafo final puede cambiar: los del grafo rehecho y las esquinas de los bloques.
+    std::vector<unsigned int> touched;
+
+    for(y = gy0; y < gy1; ++y)
+    {
+        for(x = gx0; x < gx1; ++x)
+        {
+            touched.push_back(x + y * width);
+        }
+    }
+
+    for(unsigned int b = 0; b < blocks.size(); ++b)
+    {
+        touched.push_back(blocks[b]);
+        touched.push_back(blocks[b] + 1);
+        touched.push_back(blocks[b] + width);
+        touched.push_back(blocks[b] + width + 1);
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    std::vector<uint8_t> previous(touched.size());
+
+    for(unsigned int i = 0; i < touched.size(); ++i)
+    {
+        previous[i] = result.similarityGraph[touched[i]];
+    }
+
+    for(y = gy0; y < gy1; ++y)
+    {
+        memcpy(result.similarityGraph + gx0 + y * width, editor->unresolvedGraph + gx0 + y * width, gx1 - gx0);
+    }
+
+    simplifyCrossesInBlocks(result.similarityGraph, editor->unresolvedGraph, width, height, blocks);
+
+    //  Celdas a rehacer: las de los píxeles con el grafo cambiado y sus 4 vecinos, y las del rectángulo.
+    std::vector<unsigned int> cells;
+
+    for(unsigned int i = 0; i < touched.size(); ++i)
+    {
+        unsigned int p = touched[i];
+
+        if(result.similarityGraph[p] == previous[i])
+        {
+            continue;
+        }
+
+        x = p % width;
+        y = p / width;
+
+        cells.push_back(p);
+
+        if(x > 0)
+        {
+            cells.push_back(p - 1);
+        }
+
+        if(x < width - 1)
+        {
+            cells.push_back(p + 1);
+        }
+
+        if(y > 0)
+        {
+            cells.push_back(p - width);
+        }
+
+        if(y < height - 1)
+        {
+            cells.push_back(p + width);
+        }
+    }
+
+    for(y = y0; y < y1; ++y)
+    {
+        for(x = x0; x < x1; ++x)
+        {
+            cells.push_back(x + y * width);
+        }
+    }
+
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    std::vector<unsigned int> previousSizes;
+
+    updateVoronoiGraph(result.voronoiGraph, result.similarityGraph, cells, previousSizes);
+    updateVoronoiMesh(result.voronoiMesh, result.voronoiGraph, previousSizes, pixels, stride, cells);
+    updateCurves(result.curves, editor->curveIndex, result.voronoiMesh, result.voronoiGraph, cells, stats.curvesRemoved,
+                 stats.curvesAdded);
+
+    stats.pixels = (gx1 - gx0) * (gy1 - gy0);
+    stats.blocks = blocks.size();
+    stats.cells = cells.size();
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Cambio en (" << x0 << ", " << y0 << ")-(" << x1 << ", " << y1 << "): "
+                                        << stats.blocks << " bloques, " << stats.cells << " celdas, "
+                                        << stats.curvesRemoved << " curvas quitadas, " << stats.curvesAdded << " nuevas");
+
+    return true;
+}
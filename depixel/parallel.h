@@ -0,0 +1,61 @@
+/*
+ * Reparto de trabajo entre hilos para libdepixel.
+ */
+
+#ifndef __DEPIXEL_PARALLEL_H_
+#define __DEPIXEL_PARALLEL_H_
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+//  Número de hilos por defecto: uno por núcleo.
+inline unsigned int workerCount(void)
+{
+    unsigned int numCores = std::thread::hardware_concurrency();
+
+    return numCores > 0 ? numCores : 1;
+}
+
+//  Ejecuta func(i) para cada i en [0, count) repartiendo los índices entre numThreads hilos (0 = uno por núcleo).
+// Cada hilo va cogiendo el siguiente índice libre, así que trabajos de distinta duración se equilibran solos. El hilo
+// que llama también trabaja, y con un solo hilo no se crea ninguno.
+template<class Func>
+void parallelFor(int count, Func func, unsigned int numThreads = 0)
+{
+    if(numThreads == 0)
+    {
+        numThreads = workerCount();
+    }
+
+    if(numThreads > (unsigned int)count)
+    {
+        numThreads = count > 0 ? count : 1;
+    }
+
+    std::atomic<int> next(0);
+
+    auto worker = [&]()
+    {
+        for(int i = next++; i < count; i = next++)
+        {
+            func(i);
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    for(unsigned int t = 1; t < numThreads; ++t)
+    {
+        threads.push_back(std::thread(worker));
+    }
+
+    worker();
+
+    for(unsigned int t = 0; t < threads.size(); ++t)
+    {
+        threads[t].join();
+    }
+}
+
+#endif
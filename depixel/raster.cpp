@@ -0,0 +1,275 @@
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "depixel.h"
+#include "parallel.h"
+#include "trace.h"
+
+//  Rasterizado del resultado a un bitmap de 32 bits a cualquier escala, sin SDL. La salida se parte en tiles de
+// DEPIXEL_RASTER_TILE_SIZE x DEPIXEL_RASTER_TILE_SIZE píxeles que se reparten entre los hilos; cada tile dibuja las
+// celdas que lo tocan con antialiasing por cobertura: cada píxel de salida mezcla los colores de las celdas que lo
+// cubren en proporción al área que cubre cada una (las celdas no se solapan y cubren toda la imagen).
+#ifndef DEPIXEL_RASTER_TILE_SIZE
+    #define DEPIXEL_RASTER_TILE_SIZE 64
+#endif
+
+//  Acumuladores de un píxel de salida: cobertura total y cada canal (alfa, rojo, verde, azul) por su cobertura. Como
+// en el resto de la librería, el alfa no cuenta para nada más: se mezcla como los demás canales.
+#define RASTER_CHANNELS 5
+
+//  Suma en coverage (filas de width valores) el área con signo del lado (x0, y0)-(x1, y1) en cada píxel que cruza,
+// como en los rasterizadores de fuentes: sumando después cada fila de izquierda a derecha queda, en cada píxel, la
+// parte cubierta por el polígono (con el signo de su orientación). Las coordenadas tienen que estar dentro de
+// [0, width - 2] x [0, altura]. El corte con cada fila se calcula desde los extremos y se recorta a ese rango: sumando
+// fila a fila el error de redondeo lo sacaba del buffer en los lados pegados al borde.
+static void accumulateEdge(float* coverage, int width, int height, float x0, float y0, float x1, float y1)
+{
+    float dir = 1.0f;
+
+    if(y0 == y1)
+    {
+        return;
+    }
+
+    if(y0 > y1)
+    {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+        dir = -1.0f;
+    }
+
+    float dxdy = (x1 - x0) / (y1 - y0);
+    float xMax = (float)(width - 2);
+    int yEnd = std::min(height, (int)std::ceil(y1));
+
+    for(int y = (int)y0; y < yEnd; ++y)
+    {
+        float* row = coverage + y * width;
+        float rowY0 = std::max((float)y, y0);
+        float rowY1 = std::min((float)(y + 1), y1);
+        float dy = rowY1 - rowY0;
+        float x = std::min(xMax, std::max(0.0f, x0 + dxdy * (rowY0 - y0)));
+        float xNext = rowY1 == y1 ? x1 : std::min(xMax, std::max(0.0f, x0 + dxdy * (rowY1 - y0)));
+        float d = dy * dir;
+        float left = std::min(x, xNext);
+        float right = std::max(x, xNext);
+        float leftFloor = std::floor(left);
+        float rightCeil = std::ceil(right);
+        int l = (int)leftFloor;
+        int r = (int)rightCeil;
+
+        if(r <= l + 1)
+        {
+            //  El lado no sale del píxel l en esta fila.
+            float middle = 0.5f * (x + xNext) - leftFloor;
+
+            row[l] += d - d * middle;
+            row[l + 1] += d * middle;
+        }
+        else
+        {
+            float s = 1.0f / (right - left);
+            float leftFraction = left - leftFloor;
+            float firstArea = 0.5f * s * (1.0f - leftFraction) * (1.0f - leftFraction);
+            float rightFraction = right - rightCeil + 1.0f;
+            float lastArea = 0.5f * s * rightFraction * rightFraction;
+
+            row[l] += d * firstArea;
+
+            if(r == l + 2)
+            {
+                row[l + 1] += d * (1.0f - firstArea - lastArea);
+            }
+            else
+            {
+                float area = s * (1.5f - leftFraction);
+
+                row[l + 1] += d * (area - firstArea);
+
+                for(int i = l + 2; i < r - 1; ++i)
+                {
+                    row[i] += d * s;
+                }
+
+                area += (r - l - 3) * s;
+                row[r - 1] += d * (1.0f - area - lastArea);
+            }
+
+            row[r] += d * lastArea;
+        }
+    }
+}
+
+//  Dibuja en sums (los acumuladores del tile [tileX0, tileX1) x [tileY0, tileY1)) todas las celdas que lo tocan.
+static void rasterizeTile(const DepixelResult& result, float scale, int tileX0, int tileY0, int tileX1, int tileY1,
+                          float* sums, std::vector<float>& coverage, std::vector<float>& points)
+{
+    const VoronoiGraph& voronoiGraph = result.voronoiGraph;
+    int tileWidth = tileX1 - tileX0;
+
+    //  Las celdas se salen como mucho un cuarto de píxel de su píxel.
+    int pxBegin = std::max(0, (int)std::floor(tileX0 / scale) - 1);
+    int pxEnd = std::min(result.width, (int)std::ceil(tileX1 / scale) + 1);
+    int pyBegin = std::max(0, (int)std::floor(tileY0 / scale) - 1);
+    int pyEnd = std::min(result.height, (int)std::ceil(tileY1 / scale) + 1);
+    float toOutput = scale * 0.25f;
+
+    for(int py = pyBegin; py < pyEnd; ++py)
+    {
+        for(int px = pxBegin; px < pxEnd; ++px)
+        {
+            VoronoiCell cell = voronoiGraph.cell(px, py);
+
+            if(cell.size < 3)
+            {
+                continue;
+            }
+
+            points.resize(cell.size * 2);
+
+            for(unsigned int v = 0; v < cell.size; ++v)
+            {
+                points[v * 2] = ((px << 2) + cell.vertices[v * 2]) * toOutput;
+                points[(v * 2) + 1] = ((py << 2) + cell.vertices[(v * 2) + 1]) * toOutput;
+            }
+
+            float minX = points[0], maxX = points[0];
+            float minY = points[1], maxY = points[1];
+
+            for(unsigned int v = 1; v < cell.size; ++v)
+            {
+                minX = std::min(minX, points[v * 2]);
+                maxX = std::max(maxX, points[v * 2]);
+                minY = std::min(minY, points[(v * 2) + 1]);
+                maxY = std::max(maxY, points[(v * 2) + 1]);
+            }
+
+            if(maxX <= tileX0 || minX >= tileX1 || maxY <= tileY0 || minY >= tileY1)
+            {
+                continue;
+            }
+
+            //  La celda se dibuja en un buffer de su tamaño, con una columna de más para el área que sale por la
+            // derecha.
+            int boxX = (int)std::floor(minX);
+            int boxY = (int)std::floor(minY);
+            int boxWidth = (int)std::ceil(maxX) - boxX + 2;
+            int boxHeight = std::max(1, (int)std::ceil(maxY) - boxY);
+
+            coverage.assign(boxWidth * boxHeight, 0.0f);
+
+            for(unsigned int v = 0; v < cell.size; ++v)
+            {
+                unsigned int next = v + 1 < cell.size ? v + 1 : 0;
+
+                accumulateEdge(&coverage[0], boxWidth, boxHeight, points[v * 2] - boxX, points[(v * 2) + 1] - boxY,
+                               points[next * 2] - boxX, points[(next * 2) + 1] - boxY);
+            }
+
+            uint32_t color = result.voronoiMesh.faceColors[px + py * result.width];
+            float alpha = (float)(color >> 24);
+            float red = (float)((color >> 16) & 0xFF);
+            float green = (float)((color >> 8) & 0xFF);
+            float blue = (float)(color & 0xFF);
+
+            int yBegin = std::max(boxY, tileY0);
+            int yEnd = std::min(boxY + boxHeight, tileY1);
+
+            for(int y = yBegin; y < yEnd; ++y)
+            {
+                const float* row = &coverage[(y - boxY) * boxWidth];
+                float* out = sums + (y - tileY0) * tileWidth * RASTER_CHANNELS;
+                float area = 0.0f;
+
+                for(int i = 0; i < boxWidth; ++i)
+                {
+                    area += row[i];
+
+                    int x = boxX + i;
+                    float a = std::min(1.0f, std::fabs(area));
+
+                    if(x < tileX0 || x >= tileX1 || a <= 0.0f)
+                    {
+                        continue;
+                    }
+
+                    float* sum = out + (x - tileX0) * RASTER_CHANNELS;
+
+                    sum[0] += a;
+                    sum[1] += a * alpha;
+                    sum[2] += a * red;
+                    sum[3] += a * green;
+                    sum[4] += a * blue;
+                }
+            }
+        }
+    }
+}
+
+static inline uint32_t channel(float value)
+{
+    return (uint32_t)std::min(255.0f, std::max(0.0f, value + 0.5f));
+}
+
+//  Dibuja las celdas de result escaladas por scale (entera o no, píxeles de salida por píxel de la imagen) en un buffer
+// nuevo de outWidth x outHeight píxeles 0xAARRGGBB, sin relleno entre filas. Se libera con delete []. Devuelve 0 si la
+// escala no es válida.
+uint32_t* rasterizeCells(const DepixelResult& result, float scale, int& outWidth, int& outHeight, unsigned int numThreads)
+{
+    if(!(scale > 0.0f) || result.width <= 0 || result.height <= 0)
+    {
+        return 0;
+    }
+
+    outWidth = std::max(1, (int)std::ceil(result.width * scale));
+    outHeight = std::max(1, (int)std::ceil(result.height * scale));
+
+    uint32_t* output = new uint32_t[(size_t)outWidth * outHeight];
+    int tilesX = (outWidth + DEPIXEL_RASTER_TILE_SIZE - 1) / DEPIXEL_RASTER_TILE_SIZE;
+    int tilesY = (outHeight + DEPIXEL_RASTER_TILE_SIZE - 1) / DEPIXEL_RASTER_TILE_SIZE;
+    int width = outWidth;
+    int height = outHeight;
+
+    parallelFor(tilesX * tilesY, [&](int tile)
+    {
+        int x0 = (tile % tilesX) * DEPIXEL_RASTER_TILE_SIZE;
+        int y0 = (tile / tilesX) * DEPIXEL_RASTER_TILE_SIZE;
+        int x1 = std::min(width, x0 + DEPIXEL_RASTER_TILE_SIZE);
+        int y1 = std::min(height, y0 + DEPIXEL_RASTER_TILE_SIZE);
+        int tileWidth = x1 - x0;
+
+        float* sums = new float[tileWidth * (y1 - y0) * RASTER_CHANNELS]();
+        std::vector<float> coverage;
+        std::vector<float> points;
+
+        rasterizeTile(result, scale, x0, y0, x1, y1, sums, coverage, points);
+
+        for(int y = y0; y < y1; ++y)
+        {
+            const float* sum = sums + (y - y0) * tileWidth * RASTER_CHANNELS;
+            uint32_t* out = output + (size_t)y * width;
+
+            for(int x = x0; x < x1; ++x, sum += RASTER_CHANNELS)
+            {
+                //  La cobertura total es 1 salvo por redondeos; con 0 el píxel queda transparente.
+                if(sum[0] <= 0.0f)
+                {
+                    out[x] = 0;
+                    continue;
+                }
+
+                float weight = 1.0f / sum[0];
+
+                out[x] = (channel(sum[1] * weight) << 24) | (channel(sum[2] * weight) << 16)
+                       | (channel(sum[3] * weight) << 8) | channel(sum[4] * weight);
+            }
+        }
+
+        delete [] sums;
+    }, numThreads);
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Rasterizado " << outWidth << "x" << outHeight << " en " << tilesX * tilesY << " tiles");
+
+    return output;
+}
@@ -0,0 +1,372 @@
+#include "depixel.h"
+
+//  Kernels vectoriales para el grafo de similitud. Cada uno compara 4 (SSE2) u 8 (AVX2) píxeles a la vez con sus 8
+// vecinos y da exactamente los mismos patrones que hqxDiff: para cada vecino se calcula la diferencia absoluta byte a
+// byte de los YUV empaquetados, se le restan (con saturación) los umbrales de hqx y el vecino es similar si no queda
+// nada en ningún canal. Se avanza de 16 en 16 píxeles para empaquetar los patrones a un byte por píxel.
+//
+//  Aquí están también los kernels de un paso de la optimización de las splines (spline.cpp), que se eligen a la vez y
+// con el mismo juego de instrucciones.
+//
+//  La elección se hace en tiempo de ejecución según la CPU (initAlgorithm). Fuera de x86 con GCC/Clang sólo están los
+// kernels escalares.
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #define DEPIXEL_X86_KERNELS
+    #include <immintrin.h>
+#endif
+
+//  Umbrales de hqxDiff por canal en un YUV empaquetado 0x00YYUUVV: Y > 0x30, U > 0x07, V > 0x06.
+#define HQX_THRESHOLDS 0x00300706
+
+static void similarityRowScalar(const unsigned int* prevRow, const unsigned int* row, const unsigned int* nextRow,
+                                uint8_t* out, int xBegin, int xEnd)
+{
+    //  Sólo se piden píxeles interiores (xEnd <= width - 1), así que hqxGetPattern no necesita el ancho real.
+    int width = xEnd + 1;
+
+    for(int x = xBegin; x < xEnd; ++x)
+    {
+        out[x] = hqxGetPattern(prevRow, row, nextRow, x, width);
+    }
+}
+
+//  Un paso de descenso de gradiente de la energía de las splines para los puntos [begin, end), leyendo x, y y
+// escribiendo outX, outY. La suavidad de cada punto es el cuadrado de la segunda diferencia de los puntos de control
+// (la curvatura del B-spline), y su gradiente toca las tres segundas diferencias en que aparece el punto, así que se
+// leen dos puntos a cada lado. El término de posición es positionWeight * |p - p0|^4. movable vale 1 para los puntos
+// que se mueven y 0 para los fijos. Devuelve el mayor desplazamiento al cuadrado.
+static inline float splineStepPoint(const float* x, const float* y, const float* x0, const float* y0, const float* movable,
+                                    float* outX, float* outY, int i, float step, float positionWeight)
+{
+    float dm, d0, dp, gx, gy, dx, dy, r2, moveX, moveY;
+
+    dm = x[i - 2] - (2.0f * x[i - 1]) + x[i];
+    d0 = x[i - 1] - (2.0f * x[i]) + x[i + 1];
+    dp = x[i] - (2.0f * x[i + 1]) + x[i + 2];
+    gx = 2.0f * (dm - (2.0f * d0) + dp);
+
+    dm = y[i - 2] - (2.0f * y[i - 1]) + y[i];
+    d0 = y[i - 1] - (2.0f * y[i]) + y[i + 1];
+    dp = y[i] - (2.0f * y[i + 1]) + y[i + 2];
+    gy = 2.0f * (dm - (2.0f * d0) + dp);
+
+    dx = x[i] - x0[i];
+    dy = y[i] - y0[i];
+    r2 = (dx * dx) + (dy * dy);
+    gx += 4.0f * positionWeight * r2 * dx;
+    gy += 4.0f * positionWeight * r2 * dy;
+
+    moveX = step * movable[i] * gx;
+    moveY = step * movable[i] * gy;
+    outX[i] = x[i] - moveX;
+    outY[i] = y[i] - moveY;
+
+    return (moveX * moveX) + (moveY * moveY);
+}
+
+static float splineStepScalar(const float* x, const float* y, const float* x0, const float* y0, const float* movable,
+                              float* outX, float* outY, int begin, int end, float step, float positionWeight)
+{
+    float maxMove = 0.0f, move;
+
+    for(int i = begin; i < end; ++i)
+    {
+        move = splineStepPoint(x, y, x0, y0, movable, outX, outY, i, step, positionWeight);
+        maxMove = move > maxMove ? move : maxMove;
+    }
+
+    return maxMove;
+}
+
+#ifdef DEPIXEL_X86_KERNELS
+
+//  Pone bit en pattern para cada píxel similar a su vecino.
+#define SSE2_SIMILAR(neighbour, bit)                                                                        \
+    {                                                                                                       \
+        __m128i n = _mm_loadu_si128((const __m128i*)(neighbour));                                           \
+        __m128i diff = _mm_or_si128(_mm_subs_epu8(center, n), _mm_subs_epu8(n, center));                    \
+        __m128i similar = _mm_cmpeq_epi32(_mm_subs_epu8(diff, thresholds), zero);                           \
+        pattern = _mm_or_si128(pattern, _mm_and_si128(similar, _mm_set1_epi32(bit)));                      \
+    }
+
+//  Patrones de los 4 píxeles que empiezan en x, uno en cada palabra de 32 bits.
+__attribute__((target("sse2")))
+static inline __m128i similarityPatternsSSE2(const unsigned int* prevRow, const unsigned int* row,
+                                             const unsigned int* nextRow, int x)
+{
+    const __m128i thresholds = _mm_set1_epi32(HQX_THRESHOLDS);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i center = _mm_loadu_si128((const __m128i*)(row + x));
+    __m128i pattern = zero;
+
+    SSE2_SIMILAR(prevRow + x - 1, 0x01);
+    SSE2_SIMILAR(prevRow + x,     0x02);
+    SSE2_SIMILAR(prevRow + x + 1, 0x04);
+    SSE2_SIMILAR(row + x - 1,     0x08);
+    SSE2_SIMILAR(row + x + 1,     0x10);
+    SSE2_SIMILAR(nextRow + x - 1, 0x20);
+    SSE2_SIMILAR(nextRow + x,     0x40);
+    SSE2_SIMILAR(nextRow + x + 1, 0x80);
+
+    return pattern;
+}
+
+__attribute__((target("sse2")))
+static void similarityRowSSE2(const unsigned int* prevRow, const unsigned int* row, const unsigned int* nextRow,
+                              uint8_t* out, int xBegin, int xEnd)
+{
+    int x = xBegin;
+
+    //  16 píxeles por vuelta: los 4 grupos de patrones de 32 bits se empaquetan a 16 bytes (los patrones caben en un
+    // byte, así que la saturación nunca actúa).
+    for(; x + 16 <= xEnd; x += 16)
+    {
+        __m128i low = _mm_packs_epi32(similarityPatternsSSE2(prevRow, row, nextRow, x),
+                                      similarityPatternsSSE2(prevRow, row, nextRow, x + 4));
+        __m128i high = _mm_packs_epi32(similarityPatternsSSE2(prevRow, row, nextRow, x + 8),
+                                       similarityPatternsSSE2(prevRow, row, nextRow, x + 12));
+
+        _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(low, high));
+    }
+
+    similarityRowScalar(prevRow, row, nextRow, out, x, xEnd);
+}
+
+#define AVX2_SIMILAR(neighbour, bit)                                                                        \
+    {                                                                                                       \
+        __m256i n = _mm256_loadu_si256((const __m256i*)(neighbour));                                        \
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu8(center, n), _mm256_subs_epu8(n, center));           \
+        __m256i similar = _mm256_cmpeq_epi32(_mm256_subs_epu8(diff, thresholds), zero);                     \
+        pattern = _mm256_or_si256(pattern, _mm256_and_si256(similar, _mm256_set1_epi32(bit)));              \
+    }
+
+//  Patrones de los 8 píxeles que empiezan en x, uno en cada palabra de 32 bits.
+__attribute__((target("avx2")))
+static inline __m256i similarityPatternsAVX2(const unsigned int* prevRow, const unsigned int* row,
+                                             const unsigned int* nextRow, int x)
+{
+    const __m256i thresholds = _mm256_set1_epi32(HQX_THRESHOLDS);
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i center = _mm256_loadu_si256((const __m256i*)(row + x));
+    __m256i pattern = zero;
+
+    AVX2_SIMILAR(prevRow + x - 1, 0x01);
+    AVX2_SIMILAR(prevRow + x,     0x02);
+    AVX2_SIMILAR(prevRow + x + 1, 0x04);
+    AVX2_SIMILAR(row + x - 1,     0x08);
+    AVX2_SIMILAR(row + x + 1,     0x10);
+    AVX2_SIMILAR(nextRow + x - 1, 0x20);
+    AVX2_SIMILAR(nextRow + x,     0x40);
+    AVX2_SIMILAR(nextRow + x + 1, 0x80);
+
+    return pattern;
+}
+
+__attribute__((target("avx2")))
+static void similarityRowAVX2(const unsigned int* prevRow, const unsigned int* row, const unsigned int* nextRow,
+                              uint8_t* out, int xBegin, int xEnd)
+{
+    int x = xBegin;
+
+    for(; x + 16 <= xEnd; x += 16)
+    {
+        //  packus trabaja por mitades de 128 bits: tras empaquetar a 16 bits el orden es 0-3, 8-11, 4-7, 12-15, y la
+        // permutación lo deja en orden antes de bajar a bytes.
+        __m256i words = _mm256_packus_epi32(similarityPatternsAVX2(prevRow, row, nextRow, x),
+                                            similarityPatternsAVX2(prevRow, row, nextRow, x + 8));
+        words = _mm256_permute4x64_epi64(words, 0xD8);
+
+        _mm_storeu_si128((__m128i*)(out + x), _mm_packus_epi16(_mm256_castsi256_si128(words),
+                                                              _mm256_extracti128_si256(words, 1)));
+    }
+
+    similarityRowSSE2(prevRow, row, nextRow, out, x, xEnd);
+}
+
+//  Gradiente de suavidad de 4 coordenadas consecutivas que empiezan en p (ver splineStepPoint).
+#define SSE2_SMOOTHNESS(p, gradient)                                                                        \
+    {                                                                                                       \
+        __m128 m2 = _mm_loadu_ps((p) - 2);                                                                  \
+        __m128 m1 = _mm_loadu_ps((p) - 1);                                                                  \
+        __m128 c = _mm_loadu_ps(p);                                                                         \
+        __m128 p1 = _mm_loadu_ps((p) + 1);                                                                  \
+        __m128 p2 = _mm_loadu_ps((p) + 2);                                                                  \
+        __m128 dm = _mm_add_ps(_mm_sub_ps(m2, _mm_mul_ps(two, m1)), c);                                     \
+        __m128 d0 = _mm_add_ps(_mm_sub_ps(m1, _mm_mul_ps(two, c)), p1);                                     \
+        __m128 dp = _mm_add_ps(_mm_sub_ps(c, _mm_mul_ps(two, p1)), p2);                                     \
+        gradient = _mm_mul_ps(two, _mm_add_ps(_mm_sub_ps(dm, _mm_mul_ps(two, d0)), dp));                    \
+    }
+
+__attribute__((target("sse2")))
+static float splineStepSSE2(const float* x, const float* y, const float* x0, const float* y0, const float* movable,
+                            float* outX, float* outY, int begin, int end, float step, float positionWeight)
+{
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 position = _mm_set1_ps(4.0f * positionWeight);
+    const __m128 steps = _mm_set1_ps(step);
+    __m128 maxMove = _mm_setzero_ps();
+    __m128 gx, gy, cx, cy, dx, dy, r2, scale, moveX, moveY;
+    float lanes[4];
+    int i = begin;
+
+    for(; i + 4 <= end; i += 4)
+    {
+        SSE2_SMOOTHNESS(x + i, gx);
+        SSE2_SMOOTHNESS(y + i, gy);
+
+        cx = _mm_loadu_ps(x + i);
+        cy = _mm_loadu_ps(y + i);
+        dx = _mm_sub_ps(cx, _mm_loadu_ps(x0 + i));
+        dy = _mm_sub_ps(cy, _mm_loadu_ps(y0 + i));
+        r2 = _mm_mul_ps(position, _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)));
+        gx = _mm_add_ps(gx, _mm_mul_ps(r2, dx));
+        gy = _mm_add_ps(gy, _mm_mul_ps(r2, dy));
+
+        scale = _mm_mul_ps(steps, _mm_loadu_ps(movable + i));
+        moveX = _mm_mul_ps(scale, gx);
+        moveY = _mm_mul_ps(scale, gy);
+        _mm_storeu_ps(outX + i, _mm_sub_ps(cx, moveX));
+        _mm_storeu_ps(outY + i, _mm_sub_ps(cy, moveY));
+
+        maxMove = _mm_max_ps(maxMove, _mm_add_ps(_mm_mul_ps(moveX, moveX), _mm_mul_ps(moveY, moveY)));
+    }
+
+    _mm_storeu_ps(lanes, maxMove);
+
+    float result = splineStepScalar(x, y, x0, y0, movable, outX, outY, i, end, step, positionWeight);
+
+    for(int lane = 0; lane < 4; ++lane)
+    {
+        result = lanes[lane] > result ? lanes[lane] : result;
+    }
+
+    return result;
+}
+
+#define AVX2_SMOOTHNESS(p, gradient)                                                                        \
+    {                                                                                                       \
+        __m256 m2 = _mm256_loadu_ps((p) - 2);                                                               \
+        __m256 m1 = _mm256_loadu_ps((p) - 1);                                                               \
+        __m256 c = _mm256_loadu_ps(p);                                                                      \
+        __m256 p1 = _mm256_loadu_ps((p) + 1);                                                               \
+        __m256 p2 = _mm256_loadu_ps((p) + 2);                                                               \
+        __m256 dm = _mm256_add_ps(_mm256_sub_ps(m2, _mm256_mul_ps(two, m1)), c);                            \
+        __m256 d0 = _mm256_add_ps(_mm256_sub_ps(m1, _mm256_mul_ps(two, c)), p1);                            \
+        __m256 dp = _mm256_add_ps(_mm256_sub_ps(c, _mm256_mul_ps(two, p1)), p2);                            \
+        gradient = _mm256_mul_ps(two, _mm256_add_ps(_mm256_sub_ps(dm, _mm256_mul_ps(two, d0)), dp));        \
+    }
+
+__attribute__((target("avx2")))
+static float splineStepAVX2(const float* x, const float* y, const float* x0, const float* y0, const float* movable,
+                            float* outX, float* outY, int begin, int end, float step, float positionWeight)
+{
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 position = _mm256_set1_ps(4.0f * positionWeight);
+    const __m256 steps = _mm256_set1_ps(step);
+    __m256 maxMove = _mm256_setzero_ps();
+    __m256 gx, gy, cx, cy, dx, dy, r2, scale, moveX, moveY;
+    float lanes[8];
+    int i = begin;
+
+    for(; i + 8 <= end; i += 8)
+    {
+        AVX2_SMOOTHNESS(x + i, gx);
+        AVX2_SMOOTHNESS(y + i, gy);
+
+        cx = _mm256_loadu_ps(x + i);
+        cy = _mm256_loadu_ps(y + i);
+        dx = _mm256_sub_ps(cx, _mm256_loadu_ps(x0 + i));
+        dy = _mm256_sub_ps(cy, _mm256_loadu_ps(y0 + i));
+        r2 = _mm256_mul_ps(position, _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)));
+        gx = _mm256_add_ps(gx, _mm256_mul_ps(r2, dx));
+        gy = _mm256_add_ps(gy, _mm256_mul_ps(r2, dy));
+
+        scale = _mm256_mul_ps(steps, _mm256_loadu_ps(movable + i));
+        moveX = _mm256_mul_ps(scale, gx);
+        moveY = _mm256_mul_ps(scale, gy);
+        _mm256_storeu_ps(outX + i, _mm256_sub_ps(cx, moveX));
+        _mm256_storeu_ps(outY + i, _mm256_sub_ps(cy, moveY));
+
+        maxMove = _mm256_max_ps(maxMove, _mm256_add_ps(_mm256_mul_ps(moveX, moveX), _mm256_mul_ps(moveY, moveY)));
+    }
+
+    _mm256_storeu_ps(lanes, maxMove);
+
+    float result = splineStepSSE2(x, y, x0, y0, movable, outX, outY, i, end, step, positionWeight);
+
+    for(int lane = 0; lane < 8; ++lane)
+    {
+        result = lanes[lane] > result ? lanes[lane] : result;
+    }
+
+    return result;
+}
+
+#endif
+
+SimilarityRowFunction similarityRowKernel = similarityRowScalar;
+SplineStepFunction splineStepKernel = splineStepScalar;
+
+static SimilarityKernel currentKernel = SIMILARITY_KERNEL_SCALAR;
+
+//  Elige el kernel del grafo de similitud. Con SIMILARITY_KERNEL_AUTO se usa el mejor que soporte la CPU; si se pide
+// uno concreto que la CPU no soporta, se devuelve false y se deja el que hubiera.
+bool selectSimilarityKernel(SimilarityKernel kernel)
+{
+#ifdef DEPIXEL_X86_KERNELS
+    __builtin_cpu_init();
+
+    bool hasSSE2 = __builtin_cpu_supports("sse2");
+    bool hasAVX2 = __builtin_cpu_supports("avx2");
+#else
+    bool hasSSE2 = false;
+    bool hasAVX2 = false;
+#endif
+
+    if(kernel == SIMILARITY_KERNEL_AUTO)
+    {
+        kernel = hasAVX2 ? SIMILARITY_KERNEL_AVX2 : (hasSSE2 ? SIMILARITY_KERNEL_SSE2 : SIMILARITY_KERNEL_SCALAR);
+    }
+
+    switch(kernel)
+    {
+        case SIMILARITY_KERNEL_SCALAR:
+            similarityRowKernel = similarityRowScalar;
+            splineStepKernel = splineStepScalar;
+            break;
+#ifdef DEPIXEL_X86_KERNELS
+        case SIMILARITY_KERNEL_SSE2:
+            if(!hasSSE2) return false;
+            similarityRowKernel = similarityRowSSE2;
+            splineStepKernel = splineStepSSE2;
+            break;
+        case SIMILARITY_KERNEL_AVX2:
+            if(!hasAVX2) return false;
+            similarityRowKernel = similarityRowAVX2;
+            splineStepKernel = splineStepAVX2;
+            break;
+#endif
+        default:
+            return false;
+    }
+
+    currentKernel = kernel;
+
+    return true;
+}
+
+const char* similarityKernelName(void)
+{
+    switch(currentKernel)
+    {
+        case SIMILARITY_KERNEL_SSE2:
+            return "sse2";
+        case SIMILARITY_KERNEL_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
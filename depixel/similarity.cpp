@@ -0,0 +1,1192 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include "depixel.h"
+#include "parallel.h"
+#include "tiles.h"
+#include "trace.h"
+
+//  Parte relativa al algoritmo HQX. Me baso principalmente en lo que hay aquí: http://code.google.com/p/hqx/
+bool hqxDiff(unsigned int yuv1, unsigned int yuv2)
+{
+    return !((abs((yuv1 & 0xFF0000) - (yuv2 & 0xFF0000)) > 0x00300000) ||
+             (abs((yuv1 & 0xFF00) - (yuv2 & 0xFF00)) > 0x00000700) ||
+             (abs((yuv1 & 0xFF) - (yuv2 & 0xFF)) > 0x00000006));
+}
+
+//  Patrón de similitud del píxel x de una fila con sus 8 vecinos. En los bordes izquierdo y derecho se repite la
+// columna del propio píxel, igual que hqx; prevRow y nextRow pueden ser la propia fila en los bordes superior e inferior.
+unsigned int hqxGetPattern(const unsigned int* prevRow, const unsigned int* row, const unsigned int* nextRow, int x, int width)
+{
+    int k;
+    uint32_t  w[10];
+    unsigned int pattern = 0;
+    unsigned int flag = 1;
+
+    //   +----+----+----+
+    //   |    |    |    |
+    //   | w1 | w2 | w3 |
+    //   +----+----+----+
+    //   |    |    |    |
+    //   | w4 | w5 | w6 |
+    //   +----+----+----+
+    //   |    |    |    |
+    //   | w7 | w8 | w9 |
+    //   +----+----+----+
+
+    w[2] = prevRow[x];
+    w[5] = row[x];
+    w[8] = nextRow[x];
+
+    if(x > 0)
+    {
+        w[1] = prevRow[x - 1];
+        w[4] = row[x - 1];
+        w[7] = nextRow[x - 1];
+    }
+    else
+    {
+        w[1] = w[2];
+        w[4] = w[5];
+        w[7] = w[8];
+    }
+
+    if(x < width - 1)
+    {
+        w[3] = prevRow[x + 1];
+        w[6] = row[x + 1];
+        w[9] = nextRow[x + 1];
+    }
+    else
+    {
+        w[3] = w[2];
+        w[6] = w[5];
+        w[9] = w[8];
+    }
+
+    for(k = 1; k <= 9; ++k)
+    {
+        if(k == 5) continue;
+
+        if(w[k] != w[5])
+        {
+            if(hqxDiff(w[5], w[k])) pattern |= flag;
+        }
+        else
+        {
+            pattern |= flag;
+
+        }
+        flag <<= 1;
+    }
+
+    return pattern;
+}
+
+//  Calcula los patrones de la fila y del grafo de similitud en out, con las máscaras de los bordes de la imagen ya
+// aplicadas. Cada patrón sólo depende de la vecindad 3x3 del píxel, así que sólo se leen las filas y - 1, y, y + 1.
+static void hqxGetSimilarityRow(unsigned int* yuvSurface, uint8_t* out, int width, int height, int y)
+{
+    const unsigned int* row = yuvSurface + y * width;
+    const unsigned int* prevRow = y > 0 ? row - width : row;
+    const unsigned int* nextRow = y < height - 1 ? row + width : row;
+
+    //  Las columnas de los bordes repiten vecinos; el interior lo calcula el kernel elegido en initAlgorithm.
+    out[0] = hqxGetPattern(prevRow, row, nextRow, 0, width);
+
+    if(width > 1)
+    {
+        out[width - 1] = hqxGetPattern(prevRow, row, nextRow, width - 1, width);
+        similarityRowKernel(prevRow, row, nextRow, out, 1, width - 1);
+    }
+
+    if(y == 0)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            out[x]                                    &= 0xF8; // &B11111000
+        }
+    }
+
+    if(y == height - 1)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            out[x]                                    &= 0x1F; // &B00011111
+        }
+    }
+
+    out[0]                                            &= 0xD6; // &B11010110
+    out[width - 1]                                    &= 0x6B; // &B01101011
+}
+
+//  Calcula las filas [yBegin, yEnd) del grafo de similitud. Bandas distintas pueden calcularse a la vez.
+static void hqxGetSimilarityGraphBand(unsigned int* yuvSurface, uint8_t* similarityGraph, int width, int height,
+                                      int yBegin, int yEnd)
+{
+    for(int y = yBegin; y < yEnd; ++y)
+    {
+        hqxGetSimilarityRow(yuvSurface, similarityGraph + y * width, width, height, y);
+    }
+}
+
+uint8_t* hqxGetSimilarityGraph(unsigned int* yuvSurface, int width, int height)
+{
+    uint8_t* similarityGraph = new uint8_t[width * height];
+
+    hqxGetSimilarityGraphBand(yuvSurface, similarityGraph, width, height, 0, height);
+
+    //std::cout << "================================================================" << std::endl;
+    //std::cout << "Similarity Graph" << std::endl;
+    //std::cout << "================================================================" << std::endl;
+    //dumpTable(similarityGraph, width, height);
+    //std::cout << "================================================================" << std::endl;
+
+    return similarityGraph;
+}
+
+//  Alto de las bandas en que se reparte el grafo entre numThreads hilos (0 = uno por núcleo): unas cuantas bandas por
+// hilo para equilibrar la carga, pero no tan finas que el reparto cueste más que el cálculo.
+static int similarityBandHeight(int height, unsigned int numThreads)
+{
+    if(numThreads == 0)
+    {
+        numThreads = workerCount();
+    }
+
+    int bandHeight = (height + (numThreads * 4) - 1) / (numThreads * 4);
+
+    return bandHeight < 16 ? 16 : bandHeight;
+}
+
+//  Igual que hqxGetSimilarityGraph, pero repartiendo bandas horizontales de filas entre numThreads hilos (0 = uno por
+// núcleo). El resultado es idéntico byte a byte al de la versión secuencial.
+uint8_t* hqxGetSimilarityGraphParallel(unsigned int* yuvSurface, int width, int height, unsigned int numThreads)
+{
+    uint8_t* similarityGraph = new uint8_t[width * height];
+    int bandHeight = similarityBandHeight(height, numThreads);
+    int numBands = (height + bandHeight - 1) / bandHeight;
+
+    parallelFor(numBands, [=](int band)
+    {
+        int yBegin = band * bandHeight;
+        int yEnd = yBegin + bandHeight < height ? yBegin + bandHeight : height;
+
+        hqxGetSimilarityGraphBand(yuvSurface, similarityGraph, width, height, yBegin, yEnd);
+    }, numThreads);
+
+    return similarityGraph;
+}
+
+//  Elimina las diagonales de los bloques 2x2 totalmente conectados entre dos filas consecutivas del grafo. Cada bloque
+// sólo mira y modifica sus propias conexiones, así que el orden en que se resuelven no importa. Devuelve cuántos
+// bloques se han simplificado.
+static unsigned int simplifyFullyBlockRows(uint8_t* top, uint8_t* bottom, int width)
+{
+    unsigned int numBlocks = 0;
+
+    const unsigned int cornerUpLeft    = 0xD0; // &B11010000
+    const unsigned int cornerUpRight   = 0x68; // &B01101000
+    const unsigned int cornerDownLeft  = 0x16; // &B00010110
+    const unsigned int cornerDownRight = 0x0B; // &B00001011
+
+    for(int x = 0; x < width - 1; ++x)
+    {
+        if(((top[x] & cornerUpLeft) == cornerUpLeft) &&
+           ((top[x + 1] & cornerUpRight) == cornerUpRight) &&
+           ((bottom[x] & cornerDownLeft) == cornerDownLeft) &&
+           ((bottom[x + 1] & cornerDownRight) == cornerDownRight))
+        {
+            top[x] &=           0x7F; // &B01111111
+            top[x + 1] &=       0xDF; // &B11011111
+            bottom[x] &=        0xFB; // &B11111011
+            bottom[x + 1] &=    0xFE; // &B11111110
+            ++numBlocks;
+        }
+    }
+
+    return numBlocks;
+}
+
+//  Simplificación del Similarity Graph obtenido por medio del algoritmo HQX
+void simplifyFullyBlockSimilarityGraph(uint8_t* similarityGraph, int width, int height)
+{
+    unsigned int numBlocks = 0;
+
+    for(int y = 0; y < height - 1; ++y)
+    {
+        numBlocks += simplifyFullyBlockRows(similarityGraph + y * width, similarityGraph + (y + 1) * width, width);
+    }
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_FULLY_CONNECTED_BLOCKS, numBlocks);
+}
+
+//  hqxGetSimilarityGraph y simplifyFullyBlockSimilarityGraph en una sola pasada sobre las filas [yBegin, yEnd): se
+// calcula la fila y + 1 en un buffer de dos filas, se resuelven los bloques 2x2 entre y e y + 1, y la fila y, que ya
+// no va a cambiar, se escribe una única vez en el grafo. Si la banda no empieza en la fila 0 se calcula antes la fila
+// yBegin - 1 (sin escribirla) para resolver los bloques que comparte con la banda anterior; los bloques sólo miran sus
+// propias conexiones, así que ambas bandas llegan al mismo resultado.
+static void hqxGetSimplifiedSimilarityGraphBand(unsigned int* yuvSurface, uint8_t* similarityGraph, int width, int height,
+                                                int yBegin, int yEnd, uint8_t* rowBuffer)
+{
+    uint8_t* current = rowBuffer;
+    uint8_t* next = rowBuffer + width;
+    uint8_t* aux;
+    unsigned int numBlocks = 0, numRowBlocks;
+
+    int y = yBegin > 0 ? yBegin - 1 : yBegin;
+
+    hqxGetSimilarityRow(yuvSurface, current, width, height, y);
+
+    for(; y < yEnd; ++y)
+    {
+        if(y < height - 1)
+        {
+            hqxGetSimilarityRow(yuvSurface, next, width, height, y + 1);
+            numRowBlocks = simplifyFullyBlockRows(current, next, width);
+
+            //  Los bloques entre la fila de halo y yBegin los cuenta la banda anterior.
+            if(y >= yBegin)
+            {
+                numBlocks += numRowBlocks;
+            }
+        }
+
+        if(y >= yBegin)
+        {
+            memcpy(similarityGraph + y * width, current, width);
+        }
+
+        aux = current;
+        current = next;
+        next = aux;
+    }
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_FULLY_CONNECTED_BLOCKS, numBlocks);
+}
+
+uint8_t* hqxGetSimplifiedSimilarityGraph(unsigned int* yuvSurface, int width, int height)
+{
+    uint8_t* similarityGraph = new uint8_t[width * height];
+    uint8_t* rowBuffer = new uint8_t[width * 2];
+
+    hqxGetSimplifiedSimilarityGraphBand(yuvSurface, similarityGraph, width, height, 0, height, rowBuffer);
+
+    delete [] rowBuffer;
+
+    return similarityGraph;
+}
+
+uint8_t* hqxGetSimplifiedSimilarityGraphParallel(unsigned int* yuvSurface, int width, int height, unsigned int numThreads)
+{
+    uint8_t* similarityGraph = new uint8_t[width * height];
+    int bandHeight = similarityBandHeight(height, numThreads);
+    int numBands = (height + bandHeight - 1) / bandHeight;
+
+    parallelFor(numBands, [=](int band)
+    {
+        int yBegin = band * bandHeight;
+        int yEnd = yBegin + bandHeight < height ? yBegin + bandHeight : height;
+        uint8_t* rowBuffer = new uint8_t[width * 2];
+
+        hqxGetSimplifiedSimilarityGraphBand(yuvSurface, similarityGraph, width, height, yBegin, yEnd, rowBuffer);
+
+        delete [] rowBuffer;
+    }, numThreads);
+
+    return similarityGraph;
+}
+
+//  Como hqxGetSimilarityRow, pero sólo los píxeles [xBegin, xEnd) de la fila y, en out[0, xEnd - xBegin).
+// kernelRow es un buffer de al menos xEnd - xBegin + 1 bytes para el kernel, que escribe desde su posición 1.
+static void hqxGetSimilarityRowRange(unsigned int* yuvSurface, uint8_t* out, int width, int height, int y,
+                                     int xBegin, int xEnd, uint8_t* kernelRow)
+{
+    const unsigned int* row = yuvSurface + y * width;
+    const unsigned int* prevRow = y > 0 ? row - width : row;
+    const unsigned int* nextRow = y < height - 1 ? row + width : row;
+    int kernelBegin = xBegin > 1 ? xBegin : 1;
+    int kernelEnd = xEnd < width - 1 ? xEnd : width - 1;
+    int shift = kernelBegin - 1;
+
+    if(kernelBegin < kernelEnd)
+    {
+        similarityRowKernel(prevRow + shift, row + shift, nextRow + shift, kernelRow, 1, kernelEnd - shift);
+        memcpy(out + kernelBegin - xBegin, kernelRow + 1, kernelEnd - kernelBegin);
+    }
+
+    if(xBegin == 0)
+    {
+        out[0] = hqxGetPattern(prevRow, row, nextRow, 0, width);
+    }
+
+    if(xEnd == width && width > 1)
+    {
+        out[width - 1 - xBegin] = hqxGetPattern(prevRow, row, nextRow, width - 1, width);
+    }
+
+    for(int x = 0; x < xEnd - xBegin; ++x)
+    {
+        if(y == 0)
+        {
+            out[x]                                    &= 0xF8; // &B11111000
+        }
+
+        if(y == height - 1)
+        {
+            out[x]                                    &= 0x1F; // &B00011111
+        }
+    }
+
+    if(xBegin == 0)
+    {
+        out[0]                                        &= 0xD6; // &B11010110
+    }
+
+    if(xEnd == width)
+    {
+        out[width - 1 - xBegin]                       &= 0x6B; // &B01101011
+    }
+}
+
+//  Grafo simplificado de los píxeles [x0, x1) x [y0, y1), escrito en su sitio de similarityGraph. Basta calcularlo
+// sobre el rectángulo con un halo de un píxel: el patrón de un píxel sólo depende de su vecindad 3x3 y un bloque 2x2
+// sólo de sus propias conexiones. window tiene que tener sitio para el rectángulo con halo y kernelRow para una fila
+// suya más un byte.
+static void hqxGetSimplifiedSimilarityRect(unsigned int* yuvSurface, uint8_t* similarityGraph, int width, int height,
+                                           int x0, int y0, int x1, int y1, uint8_t* window, uint8_t* kernelRow)
+{
+    int wx0 = x0 > 0 ? x0 - 1 : 0;
+    int wy0 = y0 > 0 ? y0 - 1 : 0;
+    int wx1 = x1 < width ? x1 + 1 : width;
+    int wy1 = y1 < height ? y1 + 1 : height;
+    int windowWidth = wx1 - wx0;
+    int y;
+
+    for(y = wy0; y < wy1; ++y)
+    {
+        hqxGetSimilarityRowRange(yuvSurface, window + (y - wy0) * windowWidth, width, height, y, wx0, wx1, kernelRow);
+    }
+
+    for(y = wy0; y < wy1 - 1; ++y)
+    {
+        simplifyFullyBlockRows(window + (y - wy0) * windowWidth, window + (y + 1 - wy0) * windowWidth, windowWidth);
+    }
+
+    for(y = y0; y < y1; ++y)
+    {
+        memcpy(similarityGraph + y * width + x0, window + (y - wy0) * windowWidth + (x0 - wx0), x1 - x0);
+    }
+}
+
+//  Igual que hqxGetSimplifiedSimilarityGraph, pero por tiles de tileSize x tileSize, para imágenes hechas de tiles
+// repetidos. Un tile da el mismo grafo que otro si son iguales con un halo de un píxel (ver groupTiles): cada tile
+// distinto se calcula una vez y los repetidos se copian. El resultado es idéntico byte a byte; sólo no se cuentan los
+// bloques simplificados. En numUniqueTiles se devuelve cuántos tiles se han calculado.
+uint8_t* hqxGetSimplifiedSimilarityGraphTiled(unsigned int* yuvSurface, int width, int height, int tileSize,
+                                              unsigned int& numUniqueTiles)
+{
+    uint8_t* similarityGraph = new uint8_t[width * height];
+    TileGrid grid;
+
+    groupTiles(yuvSurface, width, height, tileSize, grid);
+
+    uint8_t* window = new uint8_t[(tileSize + 2) * (tileSize + 2)];
+    uint8_t* kernelRow = new uint8_t[tileSize + 3];
+    int x0, y0, x1, y1, y;
+
+    for(unsigned int tile = 0; tile < grid.representative.size(); ++tile)
+    {
+        grid.bounds(tile, x0, y0, x1, y1);
+
+        if(grid.representative[tile] != tile)
+        {
+            int rx0, ry0, rx1, ry1;
+
+            grid.bounds(grid.representative[tile], rx0, ry0, rx1, ry1);
+
+            for(y = 0; y < y1 - y0; ++y)
+            {
+                memcpy(similarityGraph + (y0 + y) * width + x0, similarityGraph + (ry0 + y) * width + rx0, x1 - x0);
+            }
+
+            continue;
+        }
+
+        hqxGetSimplifiedSimilarityRect(yuvSurface, similarityGraph, width, height, x0, y0, x1, y1, window, kernelRow);
+    }
+
+    delete [] kernelRow;
+    delete [] window;
+
+    numUniqueTiles = grid.numUnique;
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Grafo por tiles: " << grid.numUnique << " distintos de " << grid.representative.size());
+
+    return similarityGraph;
+}
+
+//  Rehace el grafo de hqxGetSimplifiedSimilarityGraph en los píxeles [x0, x1) x [y0, y1) después de cambiar
+// yuvSurface. Cambiar un píxel cambia también el grafo de sus 8 vecinos: el rectángulo tiene que incluirlos.
+void hqxUpdateSimplifiedSimilarityGraph(unsigned int* yuvSurface, uint8_t* similarityGraph, int width, int height,
+                                        int x0, int y0, int x1, int y1)
+{
+    if(x0 >= x1 || y0 >= y1)
+    {
+        return;
+    }
+
+    uint8_t* window = new uint8_t[(x1 - x0 + 2) * (y1 - y0 + 2)];
+    uint8_t* kernelRow = new uint8_t[x1 - x0 + 3];
+
+    hqxGetSimplifiedSimilarityRect(yuvSurface, similarityGraph, width, height, x0, y0, x1, y1, window, kernelRow);
+
+    delete [] kernelRow;
+    delete [] window;
+}
+
+//  Añade a crosses los bloques 2x2 del grafo cuyas dos diagonales están conectadas, indexados por su píxel superior
+// izquierdo (x + y * width), en orden de filas.
+void findCrossesInSimilarityGraph(uint8_t* similarityGraph, int width, int height, CrossList& crosses)
+{
+    const unsigned int cornerUpLeft    = 0x80; // &B10000000
+    const unsigned int cornerUpRight   = 0x20; // &B00100000
+    const unsigned int cornerDownLeft  = 0x04; // &B00000100
+    const unsigned int cornerDownRight = 0x01; // &B00000001
+
+    const uint8_t* top;
+    const uint8_t* bottom;
+
+    for(int y = 0; y < height - 1; ++y)
+    {
+        top = similarityGraph + y * width;
+        bottom = top + width;
+
+        for(int x = 0; x < width - 1; ++x)
+        {
+            if((top[x] & cornerUpLeft) &&
+               (top[x + 1] & cornerUpRight) &&
+               (bottom[x] & cornerDownLeft) &&
+               (bottom[x + 1] & cornerDownRight))
+            {
+                crosses.push_back(x + y * width);
+            }
+        }
+    }
+}
+
+//  Quita de cada cruce de crosses el aspa con menos peso, o las dos si empatan.
+static void removeCrossDiagonals(uint8_t* similarityGraph, int width, const CrossList& crosses, const unsigned int* weights)
+{
+    uint8_t* sg = similarityGraph;
+    int x, y;
+    unsigned int numRemoved[3] = {0, 0, 0};
+
+    for(unsigned int i = 0; i < crosses.size(); ++i)
+    {
+        x = crosses[i] % width;
+        y = crosses[i] / width;
+
+        DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Cruce en (" << x << ", " << y << "). Peso Aspa 1: " << weights[i * 2] << "; Peso Aspa 2: " << weights[(i * 2) + 1]);
+
+        if(weights[i * 2] < weights[(i * 2) + 1])
+        {
+            sg[x + y * width] &= 0x7F;
+            sg[(x + 1) + (y + 1) * width] &= 0xFE;
+            ++numRemoved[0];
+            DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Removiendo aspa 1");
+        }
+        else if(weights[i * 2] > weights[(i * 2) + 1])
+        {
+            sg[(x + 1) + y * width] &= 0xDF;
+            sg[x + (y + 1) * width] &= 0xFB;
+            ++numRemoved[1];
+            DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Removiendo aspa 2");
+        }
+        else
+        {
+            sg[x + y * width] &= 0x7F;
+            sg[(x + 1) + (y + 1) * width] &= 0xFE;
+            sg[(x + 1) + y * width] &= 0xDF;
+            sg[x + (y + 1) * width] &= 0xFB;
+            ++numRemoved[2];
+        }
+    }
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, std::dec << "Cruces: " << crosses.size() << " (aspa 1: " << numRemoved[0] << "; aspa 2: " << numRemoved[1] << "; ambas: " << numRemoved[2] << ")");
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_CROSSES, crosses.size());
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_CROSSES_REMOVED_DIAGONAL_1, numRemoved[0]);
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_CROSSES_REMOVED_DIAGONAL_2, numRemoved[1]);
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_CROSSES_REMOVED_BOTH, numRemoved[2]);
+}
+
+//  Copia del grafo sin las conexiones que salen de la imagen, que es con lo que trabajan las heurísticas de los cruces.
+static uint8_t* copyWithoutBorders(const uint8_t* similarityGraph, int width, int height)
+{
+    uint8_t* similarityGraphWithoutBorders = new uint8_t[width * height];
+
+    memcpy(similarityGraphWithoutBorders, similarityGraph, sizeof(uint8_t[width * height]));
+
+    for(int x = 0; x < width; ++x)
+    {
+        similarityGraphWithoutBorders[x]                            &= 0xF8; // &B11111000
+        similarityGraphWithoutBorders[x + (height - 1) * width]     &= 0x1F; // &B00011111
+    }
+
+    for(int y = 0; y < height; ++y)
+    {
+        similarityGraphWithoutBorders[y * width]                    &= 0xD6; // &B11010110
+        similarityGraphWithoutBorders[width - 1 + y * width]        &= 0x6B; // &B01101011
+    }
+
+    //similarityGraphWithoutBorders[0]                                &= 0xFE; // &B11111110
+    //similarityGraphWithoutBorders[width - 1]                        &= 0xFB; // &B11111011
+    //similarityGraphWithoutBorders[(height - 1) * width]             &= 0xDF; // &B11011111
+    //similarityGraphWithoutBorders[width - 1 + (height - 1) * width] &= 0x7F; // &B01111111
+
+    return similarityGraphWithoutBorders;
+}
+
+void simplifyCrossesSimilarityGraph(uint8_t* similarityGraph, int width, int height)
+{
+    uint8_t* similarityGraphWithoutBorders = copyWithoutBorders(similarityGraph, width, height);
+
+    if(DEPIXEL_TRACE_ENABLED(DEPIXEL_TRACE_TABLES))
+    {
+        std::cout << "================================================================" << std::endl;
+        std::cout << "Similarity Graph++" << std::endl;
+        std::cout << "================================================================" << std::endl;
+        dumpTable(similarityGraphWithoutBorders, width, height);
+        std::cout << "================================================================" << std::endl;
+    }
+
+    //  Los cruces se buscan una sola vez; las heurísticas y la resolución recorren sólo esa lista. Resolver un cruce
+    // sólo toca sus dos diagonales, que ningún otro bloque mira, así que la lista sigue valiendo mientras se resuelve.
+    CrossList crosses;
+
+    findCrossesInSimilarityGraph(similarityGraphWithoutBorders, width, height, crosses);
+
+    //  Dos pesos (uno por cada aspa) por cada cruce.
+    unsigned int* weights = new unsigned int[crosses.size() * 2 + 1];
+
+    memset(weights, 0, sizeof(unsigned int) * (crosses.size() * 2 + 1));
+
+    getWeightCurvesFromCrossesInSimilarityGraph(weights, similarityGraphWithoutBorders, width, height, crosses);
+    getWeightSparsePixelsFromCrossesInSimilarityGraph(weights, similarityGraphWithoutBorders, width, height, crosses);
+    getWeightIslandsFromCrossesInSimilarityGraph(weights, similarityGraphWithoutBorders, width, crosses);
+
+    delete [] similarityGraphWithoutBorders;
+
+    removeCrossDiagonals(similarityGraph, width, crosses, weights);
+
+    delete [] weights;
+}
+
+//  Cadenas maximales de píxeles de valencia 2 del grafo: cada una es un camino abierto (sus extremos conectan con
+// píxeles de otra valencia) o un ciclo. Con ellas la longitud de curva de la heurística es una consulta por esquina en
+// lugar de recorrer la curva en cada cruce que la toca.
+struct ValenceChains
+{
+    int* chain;                         //  Cadena de cada píxel, -1 si no tiene valencia 2.
+    unsigned int* position;             //  Posición del píxel en su cadena.
+    uint8_t* backward;                  //  Dirección (0..7) hacia la posición anterior (o el extremo de la cadena).
+    std::vector<unsigned int> length;
+    std::vector<bool> closed;
+};
+
+//  Desplazamiento de cada dirección del patrón:   0, 1, 2
+//                                                  3, x, 4
+//                                                  5, 6, 7
+static const int directionX[8] = {-1,  0,  1, -1, 1, -1, 0, 1};
+static const int directionY[8] = {-1, -1, -1,  0, 0,  1, 1, 1};
+
+//  Primera dirección conectada del patrón distinta de exclude (-1 para no excluir ninguna).
+static inline int otherDirection(unsigned int pattern, int exclude)
+{
+    for(int d = 0; d < 8; ++d)
+    {
+        if((pattern & (1 << d)) && d != exclude)
+        {
+            return d;
+        }
+    }
+
+    return -1;
+}
+
+static void findValenceChains(uint8_t* sg, int width, int height, ValenceChains& chains)
+{
+    int size = width * height;
+    int current, next, start, direction, back;
+    unsigned int position;
+
+    chains.chain = new int[size];
+    chains.position = new unsigned int[size];
+    chains.backward = new uint8_t[size];
+
+    for(int i = 0; i < size; ++i)
+    {
+        chains.chain[i] = -1;
+    }
+
+    for(int p = 0; p < size; ++p)
+    {
+        if(valencePattern[sg[p]] != 2 || chains.chain[p] != -1)
+        {
+            continue;
+        }
+
+        //  Retrocedemos hasta un extremo de la cadena, o hasta volver a p si es un ciclo.
+        current = p;
+        direction = otherDirection(sg[p], -1);
+
+        for(;;)
+        {
+            next = current + directionX[direction] + directionY[direction] * width;
+
+            if(next == p || valencePattern[sg[next]] != 2)
+            {
+                break;
+            }
+
+            current = next;
+            direction = otherDirection(sg[current], 7 - direction);
+        }
+
+        if(next == p)
+        {
+            start = p;
+            back = otherDirection(sg[p], otherDirection(sg[p], -1));
+        }
+        else
+        {
+            start = current;
+            back = direction;
+        }
+
+        //  Y la numeramos de un extremo al otro.
+        current = start;
+        position = 0;
+
+        for(;;)
+        {
+            chains.chain[current] = chains.length.size();
+            chains.position[current] = position++;
+            chains.backward[current] = back;
+
+            direction = otherDirection(sg[current], back);
+            next = current + directionX[direction] + directionY[direction] * width;
+
+            if(next == start || valencePattern[sg[next]] != 2)
+            {
+                break;
+            }
+
+            back = 7 - direction;
+            current = next;
+        }
+
+        chains.length.push_back(position);
+        chains.closed.push_back(next == start);
+    }
+}
+
+static void freeValenceChains(ValenceChains& chains)
+{
+    delete [] chains.chain;
+    delete [] chains.position;
+    delete [] chains.backward;
+}
+
+//  Nodos de la curva que sale del píxel p de valencia 2 alejándose por la dirección from, contando p y el píxel de otra
+// valencia en que termina. Si la curva es cerrada cada nodo se cuenta una vez.
+static inline unsigned int curveLength(const ValenceChains& chains, int p, int from)
+{
+    unsigned int chain = chains.chain[p];
+
+    if(chains.closed[chain])
+    {
+        return chains.length[chain];
+    }
+    else if(from == chains.backward[p])
+    {
+        return chains.length[chain] - chains.position[p] + 1;
+    }
+    else
+    {
+        return chains.position[p] + 2;
+    }
+}
+
+void getWeightCurvesFromCrossesInSimilarityGraph(unsigned int* weights, uint8_t* similarityGraph, int width, int height,
+                                                 const CrossList& crosses)
+{
+    if(crosses.empty())
+    {
+        return;
+    }
+
+    uint8_t* sg = similarityGraph;
+
+    unsigned int w[4];
+    int corners[4];
+    int origins[4];
+
+    origins[0] = 7;
+    origins[1] = 5;
+    origins[2] = 2;
+    origins[3] = 0;
+
+    int x, y;
+
+    ValenceChains chains;
+
+    findValenceChains(sg, width, height, chains);
+
+    for(unsigned int c = 0; c < crosses.size(); ++c)
+    {
+        x = crosses[c] % width;
+        y = crosses[c] / width;
+
+        corners[0] = x + y * width;
+        corners[1] = (x + 1) + y * width;
+        corners[2] = x + (y + 1) * width;
+        corners[3] = (x + 1) + (y + 1) * width;
+
+        for(unsigned int i = 0; i < 4; ++i)
+        {
+            w[i] = valencePattern[sg[corners[i]]] == 2 ? curveLength(chains, corners[i], origins[i]) : 1;
+        }
+
+        DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Curvas en (" << x << ", " << y << "): "
+                                            << "w[0] = " << w[0] << "; "
+                                            << "w[1] = " << w[1] << "; "
+                                            << "w[2] = " << w[2] << "; "
+                                            << "w[3] = " << w[3] << "; ");
+
+        if(w[0] + w[3] >= w[1] + w[2])
+        {
+            weights[c * 2] += (w[0] + w[3] - w[1] - w[2]);
+        }
+        else
+        {
+            weights[(c * 2) + 1] += (w[1] + w[2] - w[0] - w[3]);
+        }
+    }
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_VALENCE_CHAINS, chains.length.size());
+
+    freeValenceChains(chains);
+}
+
+//  Ventana de 8x8 píxeles en un entero de 64 bits: el píxel (xd, yd) de la ventana es el bit xd + yd * 8.
+typedef uint64_t WindowMask;
+
+#define WINDOW_LOW_BITS         0x0101010101010101ULL
+#define WINDOW_NOT_FIRST_COLUMN 0xFEFEFEFEFEFEFEFEULL
+#define WINDOW_NOT_LAST_COLUMN  0x7F7F7F7F7F7F7F7FULL
+
+static inline unsigned int windowPopCount(WindowMask mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(mask);
+#else
+    unsigned int count = 0;
+
+    for(; mask; mask &= mask - 1)
+    {
+        ++count;
+    }
+
+    return count;
+#endif
+}
+
+//  Componente conexa de seed dentro de la ventana: se dilata por cada dirección hasta que deja de crecer. connections[d]
+// marca los píxeles de la ventana conectados en la dirección d; como el grafo es simétrico, el destino siempre está en
+// la imagen, y sólo hay que descartar lo que se sale de la ventana.
+static WindowMask windowFloodFill(const WindowMask* connections, WindowMask seed)
+{
+    WindowMask component = seed;
+    WindowMask previous;
+
+    do
+    {
+        previous = component;
+
+        component |= ((component & connections[0]) >> 9) & WINDOW_NOT_LAST_COLUMN;
+        component |= ((component & connections[1]) >> 8);
+        component |= ((component & connections[2]) >> 7) & WINDOW_NOT_FIRST_COLUMN;
+        component |= ((component & connections[3]) >> 1) & WINDOW_NOT_LAST_COLUMN;
+        component |= ((component & connections[4]) << 1) & WINDOW_NOT_FIRST_COLUMN;
+        component |= ((component & connections[5]) << 7) & WINDOW_NOT_LAST_COLUMN;
+        component |= ((component & connections[6]) << 8);
+        component |= ((component & connections[7]) << 9) & WINDOW_NOT_FIRST_COLUMN;
+    } while(component != previous);
+
+    return component;
+}
+
+//  Compara el tamaño de las componentes de cada aspa dentro de una ventana de 8x8 píxeles alrededor del cruce (el píxel
+// superior izquierdo del cruce es el (3, 3) de la ventana). Gana el aspa de la componente más pequeña.
+void getWeightSparsePixelsFromCrossesInSimilarityGraph(unsigned int* weights, uint8_t* similarityGraph, int width, int height,
+                                                       const CrossList& crosses)
+{
+    uint8_t* sg = similarityGraph;
+
+    int x, y, xx, yy, xd, yd;
+
+    uint64_t row;
+    WindowMask connections[8];
+    WindowMask component1, component2;
+
+    unsigned int sizeCompDiagTopLeftToBottomRight;
+    unsigned int sizeCompDiagTopRightToBottomLeft;
+
+    for(unsigned int c = 0; c < crosses.size(); ++c)
+    {
+        x = crosses[c] % width;
+        y = crosses[c] / width;
+
+        memset(connections, 0, sizeof(connections));
+
+        for(yd = 0; yd < 8; ++yd)
+        {
+            yy = y - 3 + yd;
+
+            if(yy < 0 || yy >= height)
+            {
+                continue;
+            }
+
+            //  Los 8 patrones de la fila de la ventana, uno por byte (0 fuera de la imagen)...
+            row = 0;
+
+            for(xd = 0; xd < 8; ++xd)
+            {
+                xx = x - 3 + xd;
+
+                if(xx >= 0 && xx < width)
+                {
+                    row |= (uint64_t)(sg[xx + yy * width]) << (xd * 8);
+                }
+            }
+
+            //  ...y el bit d de cada uno se junta en un byte: el producto lleva el bit bajo del byte xd al bit 56 + xd.
+            for(int d = 0; d < 8; ++d)
+            {
+                connections[d] |= ((((row >> d) & WINDOW_LOW_BITS) * 0x0102040810204080ULL) >> 56) << (yd * 8);
+            }
+        }
+
+        component1 = windowFloodFill(connections, (WindowMask)1 << (3 + 3 * 8));
+
+        if(component1 & ((WindowMask)1 << (4 + 3 * 8)))
+        {
+            //  Las dos aspas están en la misma componente: el píxel de partida del aspa 2 se queda como una componente
+            // de un solo píxel.
+            sizeCompDiagTopLeftToBottomRight = windowPopCount(component1) - 1;
+            sizeCompDiagTopRightToBottomLeft = 1;
+        }
+        else
+        {
+            component2 = windowFloodFill(connections, (WindowMask)1 << (4 + 3 * 8));
+
+            sizeCompDiagTopLeftToBottomRight = windowPopCount(component1);
+            sizeCompDiagTopRightToBottomLeft = windowPopCount(component2);
+        }
+
+        if(sizeCompDiagTopLeftToBottomRight >= sizeCompDiagTopRightToBottomLeft)
+        {
+            weights[(c * 2) + 1] += (sizeCompDiagTopLeftToBottomRight - sizeCompDiagTopRightToBottomLeft);
+        }
+        else
+        {
+            weights[c * 2] += (sizeCompDiagTopRightToBottomLeft - sizeCompDiagTopLeftToBottomRight);
+        }
+    }
+}
+
+void getWeightIslandsFromCrossesInSimilarityGraph(unsigned int* weights, uint8_t* similarityGraph, int width,
+                                                  const CrossList& crosses)
+{
+    uint8_t* sg = similarityGraph;
+
+    int x, y;
+
+    for(unsigned int c = 0; c < crosses.size(); ++c)
+    {
+        x = crosses[c] % width;
+        y = crosses[c] / width;
+
+        DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Comprobando islas en (" << x << ", " << y << ")");
+        if(valencePattern[sg[x + y * width]] == 1 || valencePattern[sg[(x + 1) + (y + 1) * width]] == 1)
+        {
+            DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Aumentando peso en aspa 1");
+            weights[c * 2] += 5;
+        }
+
+        if(valencePattern[sg[(x + 1) + y * width]] == 1 || valencePattern[sg[x + (y + 1) * width]] == 1)
+        {
+            DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Aumentando peso en aspa 2");
+            weights[(c * 2) + 1] += 5;
+        }
+    }
+}
+
+//  Como curveLength, pero recorriendo la curva en lugar de consultar las cadenas, para cuando sólo se miran unos
+// pocos cruces.
+static unsigned int walkCurveLength(const uint8_t* sg, int width, int p, int from)
+{
+    unsigned int length = 1;
+    int current = p;
+    int back = from;
+    int direction, next;
+
+    for(;;)
+    {
+        direction = otherDirection(sg[current], back);
+        next = current + directionX[direction] + directionY[direction] * width;
+
+        if(next == p)
+        {
+            return length;
+        }
+
+        ++length;
+
+        if(valencePattern[sg[next]] != 2)
+        {
+            return length;
+        }
+
+        back = 7 - direction;
+        current = next;
+    }
+}
+
+//  Amplía [rowBegin, rowEnd) con las filas de la cadena de valencia 2 del píxel p, entera y con los píxeles en que
+// acaba, y la marca en visited.
+static void walkChainRows(const uint8_t* sg, int width, int p, std::vector<bool>& visited, int& rowBegin, int& rowEnd)
+{
+    int current, next, direction;
+
+    visited[p] = true;
+    rowBegin = std::min(rowBegin, p / width);
+    rowEnd = std::max(rowEnd, p / width + 1);
+
+    for(int side = 0; side < 2; ++side)
+    {
+        current = p;
+        direction = otherDirection(sg[p], side == 0 ? -1 : otherDirection(sg[p], -1));
+
+        for(;;)
+        {
+            next = current + directionX[direction] + directionY[direction] * width;
+
+            if(next == p)
+            {
+                break;
+            }
+
+            rowBegin = std::min(rowBegin, next / width);
+            rowEnd = std::max(rowEnd, next / width + 1);
+
+            if(valencePattern[sg[next]] != 2 || visited[next])
+            {
+                break;
+            }
+
+            visited[next] = true;
+            current = next;
+            direction = otherDirection(sg[current], 7 - direction);
+        }
+    }
+}
+
+//  Filas [rowBegin, rowEnd) de las cadenas de valencia 2 que mide la heurística de curvas en los cruces de los bloques
+// con la fila de arriba en [y0, y1), con los píxeles en que acaban (vacío si no mide ninguna). Las cadenas no tienen
+// límite, así que pueden llegar muy lejos de esas filas; depixelBanded lo usa para saber si el contexto de una banda
+// basta. Cada cadena se recorre entera una sola vez, aunque la heurística sólo mide la parte que sale del cruce.
+void findCrossCurveRows(uint8_t* similarityGraph, int width, int height, int y0, int y1, int& rowBegin, int& rowEnd)
+{
+    rowBegin = height;
+    rowEnd = 0;
+    y0 = std::max(0, y0);
+    y1 = std::min(height - 1, y1);
+
+    if(y0 >= y1)
+    {
+        return;
+    }
+
+    uint8_t* sg = copyWithoutBorders(similarityGraph, width, height);
+    std::vector<bool> visited(width * height, false);
+    CrossList crosses;
+    int corners[4];
+
+    findCrossesInSimilarityGraph(sg + y0 * width, width, y1 - y0 + 1, crosses);
+
+    for(unsigned int c = 0; c < crosses.size(); ++c)
+    {
+        corners[0] = crosses[c] + y0 * width;
+        corners[1] = corners[0] + 1;
+        corners[2] = corners[0] + width;
+        corners[3] = corners[2] + 1;
+
+        for(unsigned int i = 0; i < 4; ++i)
+        {
+            if(valencePattern[sg[corners[i]]] == 2 && !visited[corners[i]])
+            {
+                walkChainRows(sg, width, corners[i], visited, rowBegin, rowEnd);
+            }
+        }
+    }
+
+    delete [] sg;
+}
+
+//  Añade a blocks los bloques 2x2 (por su píxel superior izquierdo) con alguna esquina en una cadena de valencia 2 que
+// pase por [x0, x1) x [y0, y1): son los cruces cuyo peso de curva puede cambiar si cambia el grafo del rectángulo. Las
+// cadenas se recorren enteras, así que pueden salir muy lejos del rectángulo.
+void findValenceChainBlocks(uint8_t* similarityGraph, int width, int height, int x0, int y0, int x1, int y1,
+                            CrossList& blocks)
+{
+    const uint8_t* sg = similarityGraph;
+    std::unordered_set<int> visited;
+    std::vector<int> pending;
+    int p, current, next, direction, cx, cy, bx, by;
+
+    for(int y = y0; y < y1; ++y)
+    {
+        for(int x = x0; x < x1; ++x)
+        {
+            p = x + y * width;
+
+            if(valencePattern[sg[p]] != 2 || !visited.insert(p).second)
+            {
+                continue;
+            }
+
+            //  Se sale de p en sus dos direcciones hasta el final de la cadena (o hasta volver a p si es un ciclo).
+            pending.assign(1, p);
+
+            for(int side = 0; side < 2; ++side)
+            {
+                current = p;
+                direction = otherDirection(sg[p], side == 0 ? -1 : otherDirection(sg[p], -1));
+
+                for(;;)
+                {
+                    next = current + directionX[direction] + directionY[direction] * width;
+
+                    if(valencePattern[sg[next]] != 2 || !visited.insert(next).second)
+                    {
+                        break;
+                    }
+
+                    pending.push_back(next);
+                    current = next;
+                    direction = otherDirection(sg[current], 7 - direction);
+                }
+            }
+
+            for(unsigned int i = 0; i < pending.size(); ++i)
+            {
+                cx = pending[i] % width;
+                cy = pending[i] / width;
+
+                for(by = cy - 1; by <= cy; ++by)
+                {
+                    for(bx = cx - 1; bx <= cx; ++bx)
+                    {
+                        if(bx >= 0 && by >= 0 && bx < width - 1 && by < height - 1)
+                        {
+                            blocks.push_back(bx + by * width);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+//  simplifyCrossesSimilarityGraph sólo en los bloques 2x2 de blocks (por su píxel superior izquierdo, sin repetir):
+// sus diagonales en similarityGraph se vuelven a tomar de unresolvedGraph, el grafo de antes de resolver los cruces,
+// y los que son cruces en él se resuelven con las heurísticas sobre unresolvedGraph. Con blocks todos los bloques da
+// lo mismo que simplifyCrossesSimilarityGraph; si no, blocks tiene que incluir todos los cruces cuyos pesos pueden
+// haber cambiado.
+void simplifyCrossesInBlocks(uint8_t* similarityGraph, uint8_t* unresolvedGraph, int width, int height,
+                             const CrossList& blocks)
+{
+    uint8_t* sg = similarityGraph;
+    const uint8_t* ug = unresolvedGraph;
+    CrossList crosses;
+    int x, y;
+
+    for(unsigned int i = 0; i < blocks.size(); ++i)
+    {
+        x = blocks[i] % width;
+        y = blocks[i] / width;
+
+        sg[x + y * width]               = (sg[x + y * width] & 0x7F)               | (ug[x + y * width] & 0x80);
+        sg[(x + 1) + (y + 1) * width]   = (sg[(x + 1) + (y + 1) * width] & 0xFE)   | (ug[(x + 1) + (y + 1) * width] & 0x01);
+        sg[(x + 1) + y * width]         = (sg[(x + 1) + y * width] & 0xDF)         | (ug[(x + 1) + y * width] & 0x20);
+        sg[x + (y + 1) * width]         = (sg[x + (y + 1) * width] & 0xFB)         | (ug[x + (y + 1) * width] & 0x04);
+
+        if((ug[x + y * width] & 0x80) && (ug[(x + 1) + y * width] & 0x20))
+        {
+            crosses.push_back(blocks[i]);
+        }
+    }
+
+    if(crosses.empty())
+    {
+        return;
+    }
+
+    unsigned int* weights = new unsigned int[crosses.size() * 2];
+    static const int origins[4] = {7, 5, 2, 0};
+    int corners[4];
+    unsigned int w[4];
+
+    memset(weights, 0, sizeof(unsigned int) * crosses.size() * 2);
+
+    //  La heurística de las curvas, como en getWeightCurvesFromCrossesInSimilarityGraph.
+    for(unsigned int c = 0; c < crosses.size(); ++c)
+    {
+        x = crosses[c] % width;
+        y = crosses[c] / width;
+
+        corners[0] = x + y * width;
+        corners[1] = (x + 1) + y * width;
+        corners[2] = x + (y + 1) * width;
+        corners[3] = (x + 1) + (y + 1) * width;
+
+        for(unsigned int i = 0; i < 4; ++i)
+        {
+            w[i] = valencePattern[ug[corners[i]]] == 2 ? walkCurveLength(ug, width, corners[i], origins[i]) : 1;
+        }
+
+        if(w[0] + w[3] >= w[1] + w[2])
+        {
+            weights[c * 2] += (w[0] + w[3] - w[1] - w[2]);
+        }
+        else
+        {
+            weights[(c * 2) + 1] += (w[1] + w[2] - w[0] - w[3]);
+        }
+    }
+
+    getWeightSparsePixelsFromCrossesInSimilarityGraph(weights, unresolvedGraph, width, height, crosses);
+    getWeightIslandsFromCrossesInSimilarityGraph(weights, unresolvedGraph, width, crosses);
+
+    removeCrossDiagonals(similarityGraph, width, crosses, weights);
+
+    delete [] weights;
+}
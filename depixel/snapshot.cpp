@@ -0,0 +1,242 @@
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#include "depixel.h"
+#include "trace.h"
+
+//  Snapshot de las etapas que no cambian al iterar sobre las siguientes: los píxeles, el grafo de similitud después de
+// simplifyCrossesSimilarityGraph y las celdas de extractVoronoiGraph, en arrays planos tal como están en memoria. Se
+// carga con mmap y los arrays se usan directamente desde el fichero, sin leerlo ni convertir nada.
+//
+//  El fichero es una cabecera SnapshotHeader seguida de las secciones, cada una alineada a 8 bytes:
+//      píxeles         width * height uint32_t (0xAARRGGBB, sin relleno entre filas)
+//      grafo           width * height uint8_t
+//      offsets         width * height + 1 uint32_t, los offsets del VoronoiGraph
+//      vértices        offsets[width * height] pares de int8_t, los vértices del VoronoiGraph
+//  Todo en el orden de bytes de la máquina que lo escribe; byteOrder permite rechazar los de otra. Cualquier cambio
+// de formato tiene que subir DEPIXEL_SNAPSHOT_VERSION.
+#define DEPIXEL_SNAPSHOT_MAGIC      "DPXSNAP"
+#define DEPIXEL_SNAPSHOT_VERSION    1
+#define DEPIXEL_SNAPSHOT_BYTE_ORDER 0x01020304u
+
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    int32_t width;
+    int32_t height;
+    uint32_t numCellVertices;
+    uint32_t reserved;
+    uint64_t pixelsOffset;
+    uint64_t similarityOffset;
+    uint64_t cellOffsetsOffset;
+    uint64_t cellVerticesOffset;
+    uint64_t fileSize;
+};
+
+static inline uint64_t alignSection(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+//  Rellena con ceros desde el final de una sección de size bytes hasta la siguiente.
+static bool writePadding(FILE* file, uint64_t size)
+{
+    static const char padding[8] = {0};
+    size_t count = alignSection(size) - size;
+
+    return fwrite(padding, 1, count, file) == count;
+}
+
+static bool writeSection(FILE* file, const void* data, uint64_t size)
+{
+    return fwrite(data, 1, size, file) == size && writePadding(file, size);
+}
+
+//  Guarda el snapshot de result, que tiene que salir de depixel sobre pixels (stride bytes por fila).
+bool saveSnapshot(const char* fileName, const uint32_t* pixels, int stride, const DepixelResult& result)
+{
+    if(!pixels || !result.similarityGraph || !result.voronoiGraph.offsets)
+    {
+        return false;
+    }
+
+    uint64_t numPixels = (uint64_t)result.width * result.height;
+    SnapshotHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DEPIXEL_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = DEPIXEL_SNAPSHOT_VERSION;
+    header.byteOrder = DEPIXEL_SNAPSHOT_BYTE_ORDER;
+    header.width = result.width;
+    header.height = result.height;
+    header.numCellVertices = result.voronoiGraph.offsets[numPixels];
+    header.pixelsOffset = alignSection(sizeof(header));
+    header.similarityOffset = header.pixelsOffset + alignSection(numPixels * sizeof(uint32_t));
+    header.cellOffsetsOffset = header.similarityOffset + alignSection(numPixels);
+    header.cellVerticesOffset = header.cellOffsetsOffset + alignSection((numPixels + 1) * sizeof(uint32_t));
+    header.fileSize = header.cellVerticesOffset + alignSection((uint64_t)header.numCellVertices * 2);
+
+    FILE* file = fopen(fileName, "wb");
+
+    if(!file)
+    {
+        return false;
+    }
+
+    bool ok = writeSection(file, &header, sizeof(header));
+
+    //  Las filas de la imagen pueden tener relleno; en el fichero van seguidas.
+    for(int y = 0; ok && y < result.height; ++y)
+    {
+        const uint32_t* row = (const uint32_t*)((const unsigned char*)pixels + (size_t)y * stride);
+
+        ok = fwrite(row, sizeof(uint32_t), result.width, file) == (size_t)result.width;
+    }
+
+    ok = ok && writePadding(file, numPixels * sizeof(uint32_t));
+    ok = ok && writeSection(file, result.similarityGraph, numPixels);
+    ok = ok && writeSection(file, result.voronoiGraph.offsets, (numPixels + 1) * sizeof(uint32_t));
+    ok = ok && writeSection(file, result.voronoiGraph.vertices, (uint64_t)header.numCellVertices * 2);
+
+    return (fclose(file) == 0) && ok;
+}
+
+//  Proyecta el fichero en memoria. Las páginas son copia-en-escritura: los arrays se pueden tocar sin que cambie el
+// fichero.
+static void* mapFile(const char* fileName, size_t& size)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    LARGE_INTEGER fileSize;
+    void* data = 0;
+
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_WRITECOPY, 0, 0, 0);
+
+        if(mapping)
+        {
+            data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+            size = (size_t)fileSize.QuadPart;
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+
+    return data;
+#else
+    int file = open(fileName, O_RDONLY);
+    struct stat info;
+    void* data = 0;
+
+    if(file < 0)
+    {
+        return 0;
+    }
+
+    if(fstat(file, &info) == 0 && info.st_size > 0)
+    {
+        data = mmap(0, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+        size = info.st_size;
+
+        if(data == MAP_FAILED)
+        {
+            data = 0;
+        }
+    }
+
+    close(file);
+
+    return data;
+#endif
+}
+
+static void unmapFile(void* data, size_t size)
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap(data, size);
+#endif
+}
+
+//  Carga un snapshot guardado con saveSnapshot. Sólo se comprueba la cabecera: que sea de esta versión y esta máquina
+// y que las secciones quepan en el fichero. Se libera con freeSnapshot.
+bool loadSnapshot(const char* fileName, DepixelSnapshot& snapshot)
+{
+    size_t size = 0;
+    unsigned char* data = (unsigned char*)mapFile(fileName, size);
+
+    snapshot.data = 0;
+    snapshot.size = 0;
+
+    if(!data)
+    {
+        return false;
+    }
+
+    const SnapshotHeader* header = (const SnapshotHeader*)data;
+    uint64_t numPixels = size >= sizeof(SnapshotHeader) ? (uint64_t)header->width * header->height : 0;
+
+    if(size < sizeof(SnapshotHeader) || memcmp(header->magic, DEPIXEL_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0
+       || header->version != DEPIXEL_SNAPSHOT_VERSION || header->byteOrder != DEPIXEL_SNAPSHOT_BYTE_ORDER
+       || header->width <= 0 || header->height <= 0 || header->fileSize != size
+       || header->pixelsOffset < sizeof(SnapshotHeader)
+       || ((header->pixelsOffset | header->similarityOffset | header->cellOffsetsOffset | header->cellVerticesOffset) & 7) != 0
+       || header->pixelsOffset + numPixels * sizeof(uint32_t) > header->similarityOffset
+       || header->similarityOffset + numPixels > header->cellOffsetsOffset
+       || header->cellOffsetsOffset + (numPixels + 1) * sizeof(uint32_t) > header->cellVerticesOffset
+       || header->cellVerticesOffset + (uint64_t)header->numCellVertices * 2 > size
+       || ((const uint32_t*)(data + header->cellOffsetsOffset))[numPixels] != header->numCellVertices)
+    {
+        DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Snapshot no valido: " << fileName);
+        unmapFile(data, size);
+        return false;
+    }
+
+    snapshot.width = header->width;
+    snapshot.height = header->height;
+    snapshot.pixels = (uint32_t*)(data + header->pixelsOffset);
+    snapshot.similarityGraph = data + header->similarityOffset;
+    snapshot.voronoiGraph.width = header->width;
+    snapshot.voronoiGraph.height = header->height;
+    snapshot.voronoiGraph.offsets = (unsigned int*)(data + header->cellOffsetsOffset);
+    snapshot.voronoiGraph.vertices = (int8_t*)(data + header->cellVerticesOffset);
+    snapshot.data = data;
+    snapshot.size = size;
+
+    return true;
+}
+
+void freeSnapshot(DepixelSnapshot& snapshot)
+{
+    if(snapshot.data)
+    {
+        unmapFile(snapshot.data, snapshot.size);
+    }
+
+    snapshot.data = 0;
+    snapshot.size = 0;
+    snapshot.pixels = 0;
+    snapshot.similarityGraph = 0;
+    snapshot.voronoiGraph.offsets = 0;
+    snapshot.voronoiGraph.vertices = 0;
+}
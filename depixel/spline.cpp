@@ -0,0 +1,429 @@
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "depixel.h"
+#include "parallel.h"
+#include "trace.h"
+
+//  Última etapa del paper: cada curva se convierte en un B-spline cuadrático uniforme cuyos puntos de control son los
+// vértices de la curva. Antes se resuelven las uniones en T: de las tres curvas que llegan a un vértice, las dos más
+// alineadas se juntan en una sola spline y la tercera acaba allí. El paper elige además entre bordes de sombreado y de
+// contorno según los colores, pero aquí sólo están las curvas, así que se decide por el ángulo.
+
+//  Un extremo de curva: el índice de la curva por dos, más 1 si es el último vértice.
+struct CurveEnd
+{
+    uint64_t point;
+    unsigned int end;
+
+    bool operator<(const CurveEnd& other) const
+    {
+        return point < other.point || (point == other.point && end < other.end);
+    }
+};
+
+//  Tramo de una spline: una curva, recorrida al revés si reversed.
+struct SplinePiece
+{
+    unsigned int curve;
+    bool reversed;
+};
+
+//  Spline formada por los tramos [begin, end) de la lista de tramos.
+struct SplineChain
+{
+    unsigned int begin;
+    unsigned int end;
+    bool closed;
+};
+
+#define NO_LINK 0xFFFFFFFFu
+
+static inline uint64_t pointKey(const Point& point)
+{
+    return ((uint64_t)(uint32_t)point.first << 32) | (uint32_t)point.second;
+}
+
+//  Vértice vecino del extremo end de la curva (el que da la dirección con que sale de él).
+static inline const Point& endNeighbour(const CurveList& curves, unsigned int end)
+{
+    unsigned int curve = end >> 1;
+
+    return (end & 1) ? curves.curve(curve)[curves.curveSize(curve) - 2] : curves.curve(curve)[1];
+}
+
+//  Empareja los extremos de curva que siguen la misma spline: los dos de un vértice por el que sólo pasan dos (un lazo
+// cerrado) y, en las uniones en T, los dos que salen en direcciones más opuestas.
+static void linkCurveEnds(const CurveList& curves, std::vector<unsigned int>& links)
+{
+    std::vector<CurveEnd> ends(curves.size() * 2);
+    unsigned int i, j, a, b, k;
+
+    links.assign(curves.size() * 2, NO_LINK);
+
+    for(i = 0; i < curves.size(); ++i)
+    {
+        ends[i * 2].point = pointKey(curves.curve(i)[0]);
+        ends[i * 2].end = i * 2;
+        ends[(i * 2) + 1].point = pointKey(curves.curve(i)[curves.curveSize(i) - 1]);
+        ends[(i * 2) + 1].end = (i * 2) + 1;
+    }
+
+    std::sort(ends.begin(), ends.end());
+
+    for(i = 0; i < ends.size(); i = j)
+    {
+        for(j = i + 1; j < ends.size() && ends[j].point == ends[i].point; ++j)
+        {
+        }
+
+        if(j - i == 2)
+        {
+            links[ends[i].end] = ends[i + 1].end;
+            links[ends[i + 1].end] = ends[i].end;
+        }
+        else if(j - i == 3)
+        {
+            float bestDot = 2.0f;
+            unsigned int bestA = 0, bestB = 0;
+            float dx[3], dy[3];
+
+            for(k = 0; k < 3; ++k)
+            {
+                const Point& from = curves.curve(ends[i + k].end >> 1)[(ends[i + k].end & 1) ? curves.curveSize(ends[i + k].end >> 1) - 1 : 0];
+                const Point& to = endNeighbour(curves, ends[i + k].end);
+                float length;
+
+                dx[k] = to.first - from.first;
+                dy[k] = to.second - from.second;
+                length = std::sqrt((dx[k] * dx[k]) + (dy[k] * dy[k]));
+                dx[k] /= length;
+                dy[k] /= length;
+            }
+
+            for(a = 0; a < 3; ++a)
+            {
+                for(b = a + 1; b < 3; ++b)
+                {
+                    float dot = (dx[a] * dx[b]) + (dy[a] * dy[b]);
+
+                    if(dot < bestDot)
+                    {
+                        bestDot = dot;
+                        bestA = a;
+                        bestB = b;
+                    }
+                }
+            }
+
+            links[ends[i + bestA].end] = ends[i + bestB].end;
+            links[ends[i + bestB].end] = ends[i + bestA].end;
+        }
+    }
+}
+
+//  Junta las curvas enlazadas en splines: primero las que empiezan en un extremo sin enlazar, y después las cerradas.
+static void chainSplines(const CurveList& curves, const std::vector<unsigned int>& links,
+                         std::vector<SplinePiece>& pieces, std::vector<SplineChain>& chains)
+{
+    std::vector<bool> used(curves.size(), false);
+    unsigned int curve, start, end;
+    SplineChain chain;
+
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        for(start = 0; start < curves.size() * 2; ++start)
+        {
+            if(used[start >> 1] || (pass == 0 && links[start] != NO_LINK) || (pass == 1 && (start & 1)))
+            {
+                continue;
+            }
+
+            chain.begin = pieces.size();
+            chain.closed = false;
+            end = start;
+
+            for(;;)
+            {
+                curve = end >> 1;
+                used[curve] = true;
+
+                SplinePiece piece = {curve, (end & 1) != 0};
+                pieces.push_back(piece);
+
+                //  Se sale por el otro extremo de la curva y se sigue por la que esté enlazada a él.
+                end = links[end ^ 1];
+
+                if(end == NO_LINK)
+                {
+                    break;
+                }
+
+                if(end == start)
+                {
+                    chain.closed = true;
+                    break;
+                }
+            }
+
+            chain.end = pieces.size();
+            chains.push_back(chain);
+        }
+    }
+}
+
+//  Puntos de control de una spline, en scratch (puntos de la curva) y en out. Las esquinas son los vértices en los
+// que la curva gira 90 grados o más: en el pixel art son esquinas de verdad, mientras que las escaleras sólo giran 45.
+static unsigned int fitSpline(const CurveList& curves, const SplinePiece* pieces, const SplineChain& chain,
+                              std::vector<Point>& scratch, SplineList& out)
+{
+    unsigned int numPoints, i, numCorners = 0;
+    const Point* curve;
+    int prev, next;
+
+    scratch.clear();
+
+    for(unsigned int p = chain.begin; p < chain.end; ++p)
+    {
+        curve = curves.curve(pieces[p].curve);
+        numPoints = curves.curveSize(pieces[p].curve);
+
+        //  El primer vértice de cada tramo es el último del anterior.
+        for(i = scratch.empty() ? 0 : 1; i < numPoints; ++i)
+        {
+            scratch.push_back(curve[pieces[p].reversed ? numPoints - 1 - i : i]);
+        }
+    }
+
+    //  En las cerradas el último vértice repite el primero.
+    if(chain.closed && scratch.size() > 1 && scratch.front() == scratch.back())
+    {
+        scratch.pop_back();
+    }
+
+    numPoints = scratch.size();
+
+    for(i = 0; i < numPoints; ++i)
+    {
+        bool isEnd = !chain.closed && (i == 0 || i == numPoints - 1);
+        bool isCorner = false;
+
+        if(!isEnd && numPoints > 2)
+        {
+            prev = i > 0 ? i - 1 : numPoints - 1;
+            next = i < numPoints - 1 ? i + 1 : 0;
+
+            isCorner = ((scratch[i].first - scratch[prev].first) * (scratch[next].first - scratch[i].first)) +
+                       ((scratch[i].second - scratch[prev].second) * (scratch[next].second - scratch[i].second)) <= 0;
+        }
+
+        uint8_t flags = isEnd ? SPLINE_POINT_END : (isCorner ? SPLINE_POINT_CORNER : 0);
+
+        for(int copies = (isEnd || isCorner) ? 2 : 1; copies > 0; --copies)
+        {
+            out.x.push_back(scratch[i].first);
+            out.y.push_back(scratch[i].second);
+            out.flags.push_back(flags);
+        }
+
+        numCorners += isCorner;
+    }
+
+    out.offsets.push_back(out.x.size());
+    out.closed.push_back(chain.closed);
+
+    return numCorners;
+}
+
+//  Convierte las curvas en splines. Las uniones se resuelven de una vez y el ajuste de cada spline es independiente,
+// así que se reparte entre numThreads hilos (0 = uno por núcleo) por bloques de splines; cada bloque llena su propia
+// SplineList y al final se concatenan en orden, así que el resultado no depende del número de hilos.
+SplineList fitSplines(const CurveList& curves, unsigned int numThreads)
+{
+    SplineList splines;
+    std::vector<unsigned int> links;
+    std::vector<SplinePiece> pieces;
+    std::vector<SplineChain> chains;
+
+    linkCurveEnds(curves, links);
+    chainSplines(curves, links, pieces, chains);
+
+    int blockSize = 256;
+    int numBlocks = (chains.size() + blockSize - 1) / blockSize;
+    std::vector<SplineList> blocks(numBlocks);
+    std::vector<unsigned int> blockCorners(numBlocks, 0);
+
+    parallelFor(numBlocks, [&](int block)
+    {
+        std::vector<Point> scratch;
+        SplineList& out = blocks[block];
+        unsigned int end = std::min((unsigned int)chains.size(), (unsigned int)(block + 1) * blockSize);
+
+        out.offsets.push_back(0);
+
+        for(unsigned int c = block * blockSize; c < end; ++c)
+        {
+            blockCorners[block] += fitSpline(curves, pieces.data(), chains[c], scratch, out);
+        }
+    }, numThreads);
+
+    unsigned int numCorners = 0;
+
+    splines.offsets.push_back(0);
+
+    for(int block = 0; block < numBlocks; ++block)
+    {
+        const SplineList& out = blocks[block];
+        unsigned int base = splines.x.size();
+
+        splines.x.insert(splines.x.end(), out.x.begin(), out.x.end());
+        splines.y.insert(splines.y.end(), out.y.begin(), out.y.end());
+        splines.flags.insert(splines.flags.end(), out.flags.begin(), out.flags.end());
+        splines.closed.insert(splines.closed.end(), out.closed.begin(), out.closed.end());
+
+        for(unsigned int i = 1; i < out.offsets.size(); ++i)
+        {
+            splines.offsets.push_back(base + out.offsets[i]);
+        }
+
+        numCorners += blockCorners[block];
+    }
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Splines: " << splines.size() << " (" << curves.size() << " curvas, " << numCorners << " esquinas)");
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_SPLINES, splines.size());
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_SPLINE_CORNERS, numCorners);
+
+    return splines;
+}
+
+//  Optimización de las posiciones de los puntos de control (sección 4.3 del paper): cada punto que no es un extremo ni
+// una esquina se mueve para reducir la curvatura de la spline, con una penalización por alejarse de su posición
+// inicial que crece con la cuarta potencia de la distancia. Se hace por descenso de gradiente estilo Jacobi: en cada
+// iteración todos los puntos se mueven a la vez a partir de las posiciones de la iteración anterior, así que los
+// bloques de puntos se reparten entre hilos sin coordinarse, y todas las splines de la imagen convergen juntas.
+
+//  Paso del descenso (estable mientras el gradiente no pase de 2 / SPLINE_STEP) y peso del término de posición, en
+// unidades del diagrama.
+#define SPLINE_STEP                 0.03f
+#define SPLINE_POSITION_WEIGHT      0.25f
+
+//  Puntos de control por bloque de trabajo.
+#define SPLINE_BLOCK_SIZE           4096
+
+//  Los arrays de trabajo tienen cada spline con dos puntos fantasma a cada lado, para que el paso lea los vecinos sin
+// mirar dónde empieza cada spline: en las abiertas son copias de los extremos (que no se mueven) y en las cerradas los
+// puntos del otro lado, que se copian en cada iteración. Devuelve el número de iteraciones hechas.
+unsigned int optimizeSplines(SplineList& splines, unsigned int maxIterations, float tolerance, unsigned int numThreads)
+{
+    unsigned int numSplines = splines.size();
+    unsigned int size = splines.x.size() + (numSplines * 4);
+    unsigned int i, s, begin, n, w;
+
+    if(numSplines == 0 || maxIterations == 0)
+    {
+        return 0;
+    }
+
+    std::vector<float> x(size), y(size), x0, y0, nextX(size), nextY(size), movable(size, 0.0f);
+
+    //  Pares (destino, origen) de los fantasmas de las cerradas.
+    std::vector<unsigned int> ghosts;
+
+    for(s = 0, w = 2; s < numSplines; ++s, w += n + 4)
+    {
+        begin = splines.offsets[s];
+        n = splines.splineSize(s);
+
+        for(i = 0; i < n; ++i)
+        {
+            x[w + i] = splines.x[begin + i];
+            y[w + i] = splines.y[begin + i];
+            movable[w + i] = splines.flags[begin + i] ? 0.0f : 1.0f;
+        }
+
+        if(splines.closed[s])
+        {
+            unsigned int pairs[4][2] = {{w - 2, w + n - 2}, {w - 1, w + n - 1}, {w + n, w}, {w + n + 1, w + 1}};
+
+            for(i = 0; i < 4; ++i)
+            {
+                ghosts.push_back(pairs[i][0]);
+                ghosts.push_back(pairs[i][1]);
+            }
+        }
+        else
+        {
+            x[w - 2] = x[w - 1] = x[w];
+            y[w - 2] = y[w - 1] = y[w];
+            x[w + n] = x[w + n + 1] = x[w + n - 1];
+            y[w + n] = y[w + n + 1] = y[w + n - 1];
+        }
+    }
+
+    for(i = 0; i < ghosts.size(); i += 2)
+    {
+        x[ghosts[i]] = x[ghosts[i + 1]];
+        y[ghosts[i]] = y[ghosts[i + 1]];
+    }
+
+    x0 = x;
+    y0 = y;
+    nextX = x;
+    nextY = y;
+
+    //  Los fantasmas no se mueven (movable es 0), así que el paso puede recorrer todo salvo los dos primeros y los dos
+    // últimos.
+    int numBlocks = (size - 4 + SPLINE_BLOCK_SIZE - 1) / SPLINE_BLOCK_SIZE;
+    std::vector<float> blockMove(numBlocks);
+    unsigned int iteration;
+    float maxMove;
+
+    for(iteration = 0; iteration < maxIterations; )
+    {
+        parallelFor(numBlocks, [&](int block)
+        {
+            int blockBegin = 2 + (block * SPLINE_BLOCK_SIZE);
+            int blockEnd = std::min((int)size - 2, blockBegin + SPLINE_BLOCK_SIZE);
+
+            blockMove[block] = splineStepKernel(x.data(), y.data(), x0.data(), y0.data(), movable.data(),
+                                                nextX.data(), nextY.data(), blockBegin, blockEnd, SPLINE_STEP,
+                                                SPLINE_POSITION_WEIGHT);
+        }, numThreads);
+
+        x.swap(nextX);
+        y.swap(nextY);
+
+        for(i = 0; i < ghosts.size(); i += 2)
+        {
+            x[ghosts[i]] = x[ghosts[i + 1]];
+            y[ghosts[i]] = y[ghosts[i + 1]];
+        }
+
+        ++iteration;
+
+        maxMove = *std::max_element(blockMove.begin(), blockMove.end());
+
+        if(maxMove < tolerance * tolerance)
+        {
+            break;
+        }
+    }
+
+    for(s = 0, w = 2; s < numSplines; ++s, w += n + 4)
+    {
+        begin = splines.offsets[s];
+        n = splines.splineSize(s);
+
+        for(i = 0; i < n; ++i)
+        {
+            splines.x[begin + i] = x[w + i];
+            splines.y[begin + i] = y[w + i];
+        }
+    }
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Optimizacion de splines: " << iteration << " iteraciones, desplazamiento maximo " << std::sqrt(maxMove));
+
+    return iteration;
+}
@@ -0,0 +1,326 @@
+#include <cstdio>
+#include <vector>
+
+#include "depixel.h"
+#include "trace.h"
+
+//  Exportación a SVG del resultado, en coordenadas del diagrama (4 unidades por píxel, el viewBox es la imagen a
+// escala 4). Se escribe todo a un buffer propio que se vuelca con fwrite cada SVG_BUFFER_SIZE bytes, y los números
+// (que son todos enteros) se formatean a mano: con fprintf o iostreams el formateo se come casi todo el tiempo.
+#define SVG_BUFFER_SIZE (1 << 18)
+
+struct SvgWriter
+{
+    FILE* file;
+    char* buffer;
+    unsigned int used;
+    bool ok;
+};
+
+static void flushSvg(SvgWriter& writer)
+{
+    if(writer.used > 0 && fwrite(writer.buffer, 1, writer.used, writer.file) != writer.used)
+    {
+        writer.ok = false;
+    }
+
+    writer.used = 0;
+}
+
+//  Deja sitio para size bytes (size tiene que ser menor que SVG_BUFFER_SIZE).
+static inline char* reserveSvg(SvgWriter& writer, unsigned int size)
+{
+    if(writer.used + size > SVG_BUFFER_SIZE)
+    {
+        flushSvg(writer);
+    }
+
+    return writer.buffer + writer.used;
+}
+
+static void writeText(SvgWriter& writer, const char* text)
+{
+    for(; *text; ++text)
+    {
+        *reserveSvg(writer, 1) = *text;
+        ++writer.used;
+    }
+}
+
+static inline void writeChar(SvgWriter& writer, char c)
+{
+    *reserveSvg(writer, 1) = c;
+    ++writer.used;
+}
+
+static inline void writeInt(SvgWriter& writer, int value)
+{
+    char* out = reserveSvg(writer, 12);
+    char digits[10];
+    unsigned int magnitude = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+    int numDigits = 0;
+
+    do
+    {
+        digits[numDigits++] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    }
+    while(magnitude > 0);
+
+    if(value < 0)
+    {
+        *out++ = '-';
+    }
+
+    while(numDigits > 0)
+    {
+        *out++ = digits[--numDigits];
+    }
+
+    writer.used = out - writer.buffer;
+}
+
+//  #rrggbb del color 0xAARRGGBB (el alfa no se usa, como en el resto de la librería).
+static void writeColor(SvgWriter& writer, uint32_t color)
+{
+    static const char hex[] = "0123456789abcdef";
+    char* out = reserveSvg(writer, 7);
+
+    *out++ = '#';
+
+    for(int shift = 20; shift >= 0; shift -= 4)
+    {
+        *out++ = hex[(color >> shift) & 0x0F];
+    }
+
+    writer.used = out - writer.buffer;
+}
+
+//  Trazado de una línea quebrada en un atributo d: los vértices alineados con el anterior y el siguiente se quitan.
+struct SvgPath
+{
+    Point first;
+    Point last;
+    Point pending;
+    bool hasPending;
+    bool started;
+};
+
+static void writePoint(SvgWriter& writer, const Point& point)
+{
+    writeInt(writer, point.first);
+    writeChar(writer, ' ');
+    writeInt(writer, point.second);
+}
+
+static void beginPath(SvgWriter& writer, SvgPath& path, const Point& point)
+{
+    if(path.started)
+    {
+        writeChar(writer, ' ');
+    }
+
+    writeChar(writer, 'M');
+    writePoint(writer, point);
+
+    path.first = path.last = point;
+    path.hasPending = false;
+    path.started = true;
+}
+
+static void addPathPoint(SvgWriter& writer, SvgPath& path, const Point& point)
+{
+    if(path.hasPending)
+    {
+        int dx0 = path.pending.first - path.last.first;
+        int dy0 = path.pending.second - path.last.second;
+        int dx1 = point.first - path.pending.first;
+        int dy1 = point.second - path.pending.second;
+
+        if(dx0 * dy1 != dy0 * dx1 || dx0 * dx1 + dy0 * dy1 < 0)
+        {
+            writeChar(writer, 'L');
+            writePoint(writer, path.pending);
+            path.last = path.pending;
+        }
+    }
+
+    path.pending = point;
+    path.hasPending = true;
+}
+
+//  Acaba el trazo; si close, con Z (y sin repetir el primer vértice).
+static void endPath(SvgWriter& writer, SvgPath& path, bool close)
+{
+    if(path.hasPending && !(close && path.pending == path.first))
+    {
+        writeChar(writer, 'L');
+        writePoint(writer, path.pending);
+    }
+
+    if(close)
+    {
+        writeChar(writer, 'Z');
+    }
+
+    path.hasPending = false;
+}
+
+//  Un <path> por región de color: las celdas del mismo color unidas por segmentos no visibles. Su contorno son los
+// semisegmentos visibles de sus celdas, que se recorren como en la malla: desde el final de uno, se sigue por el
+// siguiente de la celda, y si no es visible se pasa a la celda de al lado (su twin) hasta dar con uno que lo sea. Los
+// contornos exteriores y los de los agujeros quedan en sentidos contrarios, así que vale el relleno por defecto.
+static void writeRegions(SvgWriter& writer, const DepixelResult& result)
+{
+    const VoronoiMesh& voronoiMesh = result.voronoiMesh;
+    const unsigned int* offsets = result.voronoiGraph.offsets;
+    unsigned int numPixels = result.width * result.height;
+
+    std::vector<uint8_t> seen(numPixels, 0);
+    std::vector<uint8_t> traced(voronoiMesh.numHalfEdges, 0);
+    std::vector<unsigned int> region;
+    unsigned int numRegions = 0;
+
+    for(unsigned int start = 0; start < numPixels; ++start)
+    {
+        if(seen[start])
+        {
+            continue;
+        }
+
+        region.assign(1, start);
+        seen[start] = 1;
+
+        for(unsigned int i = 0; i < region.size(); ++i)
+        {
+            for(unsigned int h = offsets[region[i]]; h < offsets[region[i] + 1]; ++h)
+            {
+                if(!voronoiMesh.visible[h])
+                {
+                    unsigned int face = voronoiMesh.faces[voronoiMesh.twins[h]];
+
+                    if(!seen[face])
+                    {
+                        seen[face] = 1;
+                        region.push_back(face);
+                    }
+                }
+            }
+        }
+
+        writeText(writer, "<path fill=\"");
+        writeColor(writer, voronoiMesh.faceColors[start]);
+        writeText(writer, "\" d=\"");
+
+        SvgPath path;
+        path.started = false;
+
+        for(unsigned int i = 0; i < region.size(); ++i)
+        {
+            for(unsigned int h = offsets[region[i]]; h < offsets[region[i] + 1]; ++h)
+            {
+                if(!voronoiMesh.visible[h] || traced[h])
+                {
+                    continue;
+                }
+
+                uint32_t edge = h;
+
+                beginPath(writer, path, voronoiMesh.vertex(voronoiMesh.origins[edge]));
+
+                do
+                {
+                    traced[edge] = 1;
+                    edge = voronoiMesh.nexts[edge];
+
+                    while(!voronoiMesh.visible[edge])
+                    {
+                        edge = voronoiMesh.nexts[voronoiMesh.twins[edge]];
+                    }
+
+                    addPathPoint(writer, path, voronoiMesh.vertex(voronoiMesh.origins[edge]));
+                }
+                while(edge != h);
+
+                endPath(writer, path, true);
+            }
+        }
+
+        writeText(writer, "\"/>\n");
+        ++numRegions;
+    }
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "SVG: " << numRegions << " regiones");
+}
+
+//  Todas las curvas en un solo <path> sin relleno.
+static void writeCurves(SvgWriter& writer, const CurveList& curves)
+{
+    if(curves.size() == 0)
+    {
+        return;
+    }
+
+    writeText(writer, "<path fill=\"none\" stroke=\"#000000\" stroke-width=\"0.5\" stroke-linejoin=\"round\" d=\"");
+
+    SvgPath path;
+    path.started = false;
+
+    for(unsigned int i = 0; i < curves.size(); ++i)
+    {
+        const Point* curve = curves.curve(i);
+        unsigned int numVertices = curves.curveSize(i);
+        bool closed = numVertices > 2 && curve[0] == curve[numVertices - 1];
+
+        beginPath(writer, path, curve[0]);
+
+        for(unsigned int v = 1; v < numVertices; ++v)
+        {
+            addPathPoint(writer, path, curve[v]);
+        }
+
+        endPath(writer, path, closed);
+    }
+
+    writeText(writer, "\"/>\n");
+}
+
+//  Guarda result como SVG: las regiones de color rellenas (SVG_LAYER_CELLS) y/o las curvas (SVG_LAYER_CURVES).
+bool saveSvg(const char* fileName, const DepixelResult& result, unsigned int layers)
+{
+    SvgWriter writer = {fopen(fileName, "wb"), 0, 0, true};
+
+    if(!writer.file)
+    {
+        return false;
+    }
+
+    writer.buffer = new char[SVG_BUFFER_SIZE];
+
+    writeText(writer, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    writeInt(writer, result.width);
+    writeText(writer, "\" height=\"");
+    writeInt(writer, result.height);
+    writeText(writer, "\" viewBox=\"0 0 ");
+    writeInt(writer, result.width << 2);
+    writeChar(writer, ' ');
+    writeInt(writer, result.height << 2);
+    writeText(writer, "\">\n");
+
+    if(layers & SVG_LAYER_CELLS)
+    {
+        writeRegions(writer, result);
+    }
+
+    if(layers & SVG_LAYER_CURVES)
+    {
+        writeCurves(writer, result.curves);
+    }
+
+    writeText(writer, "</svg>\n");
+    flushSvg(writer);
+
+    delete [] writer.buffer;
+
+    return (fclose(writer.file) == 0) && writer.ok;
+}
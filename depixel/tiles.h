@@ -0,0 +1,158 @@
+/*
+ * Tiles repetidos para libdepixel: las etapas locales (grafo de similitud, celdas de Voronoi) sólo dependen de un
+ * vecindario de un píxel, así que dos tiles iguales con su halo igual dan el mismo resultado.
+ */
+
+#ifndef __DEPIXEL_TILES_H_
+#define __DEPIXEL_TILES_H_
+
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.h"
+
+//  La imagen partida en tiles de tileSize x tileSize, alineados con la esquina superior izquierda (los de la derecha y
+// abajo pueden ser más pequeños). representative[i] es el primer tile (en orden de filas) igual al tile i, o i si es
+// el primero de los suyos.
+struct TileGrid
+{
+    int width;
+    int height;
+    int tileSize;
+    int tilesX;
+    int tilesY;
+    unsigned int numUnique;
+    std::vector<unsigned int> representative;
+
+    void bounds(unsigned int tile, int& x0, int& y0, int& x1, int& y1) const
+    {
+        x0 = (tile % tilesX) * tileSize;
+        y0 = (tile / tilesX) * tileSize;
+        x1 = x0 + tileSize < width ? x0 + tileSize : width;
+        y1 = y0 + tileSize < height ? y0 + tileSize : height;
+    }
+
+    //  El tile con su halo de un píxel, recortado a la imagen.
+    void window(unsigned int tile, int& x0, int& y0, int& x1, int& y1) const
+    {
+        bounds(tile, x0, y0, x1, y1);
+
+        x0 = x0 > 0 ? x0 - 1 : 0;
+        y0 = y0 > 0 ? y0 - 1 : 0;
+        x1 = x1 < width ? x1 + 1 : width;
+        y1 = y1 < height ? y1 + 1 : height;
+    }
+};
+
+//  Dos tiles son iguales si lo son sus ventanas (tile más halo) y tocan los mismos bordes de la imagen, que es lo que
+// decide las máscaras y la forma de la ventana.
+template<class T>
+inline bool sameTileWindow(const T* data, const TileGrid& grid, unsigned int a, unsigned int b)
+{
+    int ax0, ay0, ax1, ay1, bx0, by0, bx1, by1;
+
+    grid.bounds(a, ax0, ay0, ax1, ay1);
+    grid.bounds(b, bx0, by0, bx1, by1);
+
+    if(ax1 - ax0 != bx1 - bx0 || ay1 - ay0 != by1 - by0 || (ax0 == 0) != (bx0 == 0) || (ay0 == 0) != (by0 == 0)
+       || (ax1 == grid.width) != (bx1 == grid.width) || (ay1 == grid.height) != (by1 == grid.height))
+    {
+        return false;
+    }
+
+    grid.window(a, ax0, ay0, ax1, ay1);
+    grid.window(b, bx0, by0, bx1, by1);
+
+    for(int y = 0; y < ay1 - ay0; ++y)
+    {
+        if(memcmp(data + (ay0 + y) * grid.width + ax0, data + (by0 + y) * grid.width + bx0, (ax1 - ax0) * sizeof(T)) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+template<class T>
+inline uint64_t hashTileWindow(const T* data, const TileGrid& grid, unsigned int tile)
+{
+    int x0, y0, x1, y1;
+
+    grid.bounds(tile, x0, y0, x1, y1);
+
+    uint64_t hash = hashWord(0, ((uint64_t)(x1 - x0) << 32) | (y1 - y0));
+    hash = hashWord(hash, (x0 == 0) | ((y0 == 0) << 1) | ((x1 == grid.width) << 2) | ((y1 == grid.height) << 3));
+
+    grid.window(tile, x0, y0, x1, y1);
+
+    //  Las filas se mezclan de 8 en 8 bytes, sea cual sea T.
+    size_t rowBytes = (x1 - x0) * sizeof(T);
+
+    for(int y = y0; y < y1; ++y)
+    {
+        const unsigned char* row = (const unsigned char*)(data + y * grid.width + x0);
+        size_t i = 0;
+        uint64_t word;
+
+        for(; i + 8 <= rowBytes; i += 8)
+        {
+            memcpy(&word, row + i, 8);
+            hash = hashWord(hash, word);
+        }
+
+        if(i < rowBytes)
+        {
+            word = 0;
+            memcpy(&word, row + i, rowBytes - i);
+            hash = hashWord(hash, word);
+        }
+    }
+
+    return hashFinish(hash);
+}
+
+//  Parte en tiles la imagen de width x height elementos de data y agrupa los que son iguales con su halo.
+template<class T>
+void groupTiles(const T* data, int width, int height, int tileSize, TileGrid& grid)
+{
+    grid.width = width;
+    grid.height = height;
+    grid.tileSize = tileSize;
+    grid.tilesX = (width + tileSize - 1) / tileSize;
+    grid.tilesY = (height + tileSize - 1) / tileSize;
+    grid.numUnique = 0;
+
+    unsigned int numTiles = grid.tilesX * grid.tilesY;
+    std::unordered_multimap<uint64_t, unsigned int> seen;
+
+    grid.representative.resize(numTiles);
+    seen.reserve(numTiles);
+
+    for(unsigned int tile = 0; tile < numTiles; ++tile)
+    {
+        uint64_t hash = hashTileWindow(data, grid, tile);
+        std::pair<std::unordered_multimap<uint64_t, unsigned int>::iterator,
+                  std::unordered_multimap<uint64_t, unsigned int>::iterator> candidates = seen.equal_range(hash);
+
+        grid.representative[tile] = tile;
+
+        for(; candidates.first != candidates.second; ++candidates.first)
+        {
+            if(sameTileWindow(data, grid, candidates.first->second, tile))
+            {
+                grid.representative[tile] = candidates.first->second;
+                break;
+            }
+        }
+
+        if(grid.representative[tile] == tile)
+        {
+            seen.insert(std::make_pair(hash, tile));
+            ++grid.numUnique;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * Trazas de depuración y contadores por etapa de libdepixel.
+ *
+ * El nivel de traza se fija al compilar con -DDEPIXEL_TRACE_LEVEL=n; por defecto es 0 y las trazas desaparecen del
+ * código generado (ni se formatea nada ni se evalúan sus argumentos). Los contadores se activan con
+ * -DDEPIXEL_COUNTERS=1 y se consultan con depixelCounterValue (depixel.h).
+ */
+
+#ifndef __DEPIXEL_TRACE_H_
+#define __DEPIXEL_TRACE_H_
+
+#include <iostream>
+
+#include "depixel.h"
+
+#define DEPIXEL_TRACE_STAGES    1   //  Un resumen por etapa.
+#define DEPIXEL_TRACE_DETAIL    2   //  Una línea por cruce, celda, segmento...
+#define DEPIXEL_TRACE_TABLES    3   //  Volcado de tablas completas.
+
+#ifndef DEPIXEL_TRACE_LEVEL
+    #define DEPIXEL_TRACE_LEVEL 0
+#endif
+
+#define DEPIXEL_TRACE_ENABLED(level) (DEPIXEL_TRACE_LEVEL >= (level))
+
+//  DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Cruce en (" << x << ", " << y << ")");
+#define DEPIXEL_TRACE(level, message)                                                                       \
+    do                                                                                                      \
+    {                                                                                                       \
+        if(DEPIXEL_TRACE_ENABLED(level))                                                                    \
+        {                                                                                                   \
+            std::cout << message << std::endl;                                                              \
+        }                                                                                                   \
+    } while(0)
+
+#ifndef DEPIXEL_COUNTERS
+    #define DEPIXEL_COUNTERS 0
+#endif
+
+//  Las etapas acumulan en local y suman una vez por llamada, para no tocar contadores compartidos en los bucles.
+#define DEPIXEL_COUNT(counter, value)                                                                       \
+    do                                                                                                      \
+    {                                                                                                       \
+        if(DEPIXEL_COUNTERS)                                                                                \
+        {                                                                                                   \
+            depixelCounterAdd(counter, value);                                                              \
+        }                                                                                                   \
+    } while(0)
+
+void depixelCounterAdd(DepixelCounter counter, unsigned long long value);
+
+#endif
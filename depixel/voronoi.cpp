@@ -0,0 +1,1465 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+#include "depixel.h"
+#include "tiles.h"
+#include "trace.h"
+
+//  Cada celda tiene como mucho 2 vértices por esquina: se reserva todo de una vez para el peor caso.
+#define VORONOI_MAX_CELL_VERTICES 8
+
+//  La forma de la celda alrededor de cada una de sus esquinas sólo depende del bloque 2x2 que forma el píxel con sus
+// vecinos en esa esquina. Cada esquina aporta un punto por cada uno de los dos lados que la tocan (el lado A, anterior
+// en el orden del contorno, y el lado B, posterior):
+//
+//      - si el vecino de ese lado tiene la diagonal que cruza la esquina, el punto compartido de ambos lados (la celda
+//        se recorta por la diagonal del vecino);
+//      - si no, y el píxel tiene la diagonal hacia la esquina, un punto fuera del píxel en ese lado (la celda se
+//        estira hacia el vecino diagonal);
+//      - si no, o si ese lado es un borde de la imagen, la propia esquina.
+//
+//  Si los dos puntos coinciden sólo se pone uno. Con eso las 32 combinaciones de cada esquina (los dos bordes, la
+// diagonal de cada vecino y la del píxel) se tabulan en tiempo de compilación, y la celda es la concatenación de sus
+// cuatro esquinas.
+struct VoronoiCornerShape
+{
+    int8_t shared[2];
+    int8_t corner[2];
+    int8_t outerA[2];
+    int8_t outerB[2];
+};
+
+static constexpr VoronoiCornerShape voronoiCornerShapes[4] =
+{
+    {{3, 1}, {4, 0}, {3, -1}, {5, 1}},      //  Arriba-derecha: lados de arriba y de la derecha.
+    {{3, 3}, {4, 4}, {5, 3}, {3, 5}},       //  Abajo-derecha: lados de la derecha y de abajo.
+    {{1, 3}, {0, 4}, {1, 5}, {-1, 3}},      //  Abajo-izquierda: lados de abajo y de la izquierda.
+    {{1, 1}, {0, 0}, {-1, 1}, {1, -1}}      //  Arriba-izquierda: lados de la izquierda y de arriba.
+};
+
+//  Bits de la clave de cada esquina.
+#define VORONOI_SIDE_A          0x01    //  El lado A no es un borde de la imagen.
+#define VORONOI_SIDE_B          0x02    //  El lado B no es un borde de la imagen.
+#define VORONOI_NEIGHBOUR_A     0x04    //  El vecino del lado A tiene la diagonal que cruza la esquina.
+#define VORONOI_NEIGHBOUR_B     0x08    //  El vecino del lado B tiene la diagonal que cruza la esquina.
+#define VORONOI_DIAGONAL        0x10    //  El píxel tiene la diagonal hacia la esquina.
+
+struct VoronoiCorner
+{
+    int8_t vertices[4];     //  Punto del lado A y punto del lado B.
+    uint8_t size;           //  2, o 1 si coinciden.
+};
+
+struct VoronoiCornerTable
+{
+    VoronoiCorner corners[4][32];
+};
+
+static constexpr VoronoiCornerTable makeVoronoiCornerTable(void)
+{
+    VoronoiCornerTable table = {};
+
+    for(int c = 0; c < 4; ++c)
+    {
+        const VoronoiCornerShape& shape = voronoiCornerShapes[c];
+
+        for(int key = 0; key < 32; ++key)
+        {
+            const int8_t* a = !(key & VORONOI_SIDE_A) ? shape.corner :
+                              (key & VORONOI_NEIGHBOUR_A) ? shape.shared :
+                              (key & VORONOI_DIAGONAL) ? shape.outerA : shape.corner;
+            const int8_t* b = !(key & VORONOI_SIDE_B) ? shape.corner :
+                              (key & VORONOI_NEIGHBOUR_B) ? shape.shared :
+                              (key & VORONOI_DIAGONAL) ? shape.outerB : shape.corner;
+            VoronoiCorner& entry = table.corners[c][key];
+
+            entry.vertices[0] = a[0];
+            entry.vertices[1] = a[1];
+            entry.vertices[2] = b[0];
+            entry.vertices[3] = b[1];
+            entry.size = (a[0] != b[0] || a[1] != b[1]) ? 2 : 1;
+        }
+    }
+
+    return table;
+}
+
+static constexpr VoronoiCornerTable voronoiCornerTable = makeVoronoiCornerTable();
+
+//  Clave de una esquina a partir de sus bordes y conexiones (cada argumento, 0 o distinto de 0).
+static inline unsigned int voronoiCornerKey(unsigned int sideA, unsigned int sideB, unsigned int neighbourA,
+                                            unsigned int neighbourB, unsigned int diagonal)
+{
+    return (sideA ? VORONOI_SIDE_A : 0) | (sideB ? VORONOI_SIDE_B : 0) | (neighbourA ? VORONOI_NEIGHBOUR_A : 0) |
+           (neighbourB ? VORONOI_NEIGHBOUR_B : 0) | (diagonal ? VORONOI_DIAGONAL : 0);
+}
+
+//  Escribe en vertex los vértices de la celda del píxel (x, y), cuyo patrón es *sg, y devuelve cuántos son. Sólo
+// depende del grafo del píxel y de sus 4 vecinos y de qué bordes de la imagen toca. Puede escribir hasta 2 vértices más
+// de los que devuelve.
+static inline unsigned int extractVoronoiCell(const uint8_t* sg, int x, int y, int width, int height, int8_t* vertex)
+{
+    int prevline = y > 0 ? -width : 0;
+    int nextline = y < height - 1 ? width : 0;
+    unsigned int top = y > 0;
+    unsigned int bottom = y < height - 1;
+    unsigned int up = *(sg + prevline);
+    unsigned int center = *sg;
+    unsigned int down = *(sg + nextline);
+    unsigned int left = x > 0 ? *(sg - 1) : center;
+    unsigned int right = x < width - 1 ? *(sg + 1) : center;
+    int8_t* cellBegin = vertex;
+
+    const VoronoiCorner* upRight = &voronoiCornerTable.corners[0][voronoiCornerKey(top, x < width - 1, up & 0x80, right & 0x01, center & 0x04)];
+    const VoronoiCorner* downRight = &voronoiCornerTable.corners[1][voronoiCornerKey(x < width - 1, bottom, right & 0x20, down & 0x04, center & 0x80)];
+    const VoronoiCorner* downLeft = &voronoiCornerTable.corners[2][voronoiCornerKey(bottom, x > 0, down & 0x01, left & 0x80, center & 0x20)];
+    const VoronoiCorner* upLeft = &voronoiCornerTable.corners[3][voronoiCornerKey(x > 0, top, left & 0x04, up & 0x20, center & 0x01)];
+
+    //  La celda empieza en el punto del lado de arriba de la esquina arriba-izquierda y acaba en el de su lado
+    // izquierdo. Se copian siempre los 4 bytes de cada esquina y se avanza sólo lo que ocupa.
+    vertex[0] = upLeft->vertices[2];
+    vertex[1] = upLeft->vertices[3];
+    vertex += 2;
+
+    memcpy(vertex, upRight->vertices, 4);
+    vertex += upRight->size * 2;
+    memcpy(vertex, downRight->vertices, 4);
+    vertex += downRight->size * 2;
+    memcpy(vertex, downLeft->vertices, 4);
+    vertex += downLeft->size * 2;
+
+    vertex[0] = upLeft->vertices[0];
+    vertex[1] = upLeft->vertices[1];
+    vertex += (upLeft->size - 1) * 2;
+
+    return (vertex - cellBegin) >> 1;
+}
+
+VoronoiGraph extractVoronoiGraph(uint8_t* similarityGraph, int width, int height)
+{
+    VoronoiGraph voronoiGraph;
+    unsigned int numPixels = width * height;
+
+    //  Una sola reserva: los offsets y, detrás, los vértices (2 bytes cada uno, así que caben 4 por unsigned int).
+    voronoiGraph.width = width;
+    voronoiGraph.height = height;
+    voronoiGraph.offsets = new unsigned int[numPixels + 1 + numPixels * VORONOI_MAX_CELL_VERTICES / 2];
+    voronoiGraph.vertices = (int8_t*)(voronoiGraph.offsets + numPixels + 1);
+    voronoiGraph.offsets[0] = 0;
+
+    int8_t* vertex = voronoiGraph.vertices;
+    unsigned int size;
+    int x, y;
+    uint8_t* sg = similarityGraph;
+
+    for(y = 0; y < height; ++y)
+    {
+        for(x = 0; x < width; ++x)
+        {
+            size = extractVoronoiCell(sg, x, y, width, height, vertex);
+            vertex += size * 2;
+
+            voronoiGraph.offsets[x + y * width + 1] = voronoiGraph.offsets[x + y * width] + size;
+            ++sg;
+
+            if(DEPIXEL_TRACE_ENABLED(DEPIXEL_TRACE_DETAIL) && x == 1 && y == 1)
+            {
+                std::cout << "Celda (" << x << ", " << y << ") [ " << std::hex << (unsigned int)*(sg - 1 - width) << std::dec << " ] : ";
+                for(unsigned int i = 0; i < voronoiGraph.cell(x, y).size; ++i)
+                {
+                    std::cout << "--> (" << voronoiGraph.cell(x, y).vertex(i).first << ", " << voronoiGraph.cell(x, y).vertex(i).second << ") ";
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    return voronoiGraph;
+}
+
+//  Igual que extractVoronoiGraph, pero por tiles de tileSize x tileSize: la celda de un píxel sólo depende del grafo
+// en su vecindad, así que tiles con el mismo grafo en su ventana con halo (ver groupTiles) tienen las mismas celdas
+// (relativas a su píxel). Las de cada tile distinto se calculan una vez y las de los repetidos se copian fila a fila.
+// En numUniqueTiles se devuelve cuántos tiles se han calculado.
+VoronoiGraph extractVoronoiGraphTiled(uint8_t* similarityGraph, int width, int height, int tileSize,
+                                     unsigned int& numUniqueTiles)
+{
+    VoronoiGraph voronoiGraph;
+    unsigned int numPixels = width * height;
+    TileGrid grid;
+
+    groupTiles(similarityGraph, width, height, tileSize, grid);
+
+    //  Celdas de los tiles distintos, en orden de filas dentro de cada tile: tamaño de cada celda, vértices, y dónde
+    // empieza cada fila del tile en los vértices (tileSize + 1 por tile).
+    std::vector<uint8_t> tileSizes;
+    std::vector<int8_t> tileVertices;
+    std::vector<unsigned int> tileRows;
+    std::vector<unsigned int> firstSize(grid.representative.size());
+    std::vector<unsigned int> firstRow(grid.representative.size());
+    int8_t cell[VORONOI_MAX_CELL_VERTICES * 2 + 4];
+    int x0, y0, x1, y1, x, y;
+
+    for(unsigned int tile = 0; tile < grid.representative.size(); ++tile)
+    {
+        if(grid.representative[tile] != tile)
+        {
+            continue;
+        }
+
+        grid.bounds(tile, x0, y0, x1, y1);
+        firstSize[tile] = tileSizes.size();
+        firstRow[tile] = tileRows.size();
+
+        for(y = y0; y < y1; ++y)
+        {
+            tileRows.push_back(tileVertices.size() >> 1);
+
+            for(x = x0; x < x1; ++x)
+            {
+                unsigned int size = extractVoronoiCell(similarityGraph + x + y * width, x, y, width, height, cell);
+
+                tileSizes.push_back(size);
+                tileVertices.insert(tileVertices.end(), cell, cell + size * 2);
+            }
+        }
+
+        tileRows.push_back(tileVertices.size() >> 1);
+    }
+
+    voronoiGraph.width = width;
+    voronoiGraph.height = height;
+    voronoiGraph.offsets = new unsigned int[numPixels + 1 + numPixels * VORONOI_MAX_CELL_VERTICES / 2];
+    voronoiGraph.vertices = (int8_t*)(voronoiGraph.offsets + numPixels + 1);
+    voronoiGraph.offsets[0] = 0;
+
+    unsigned int* offset = voronoiGraph.offsets;
+
+    for(y = 0; y < height; ++y)
+    {
+        for(int tx = 0; tx < grid.tilesX; ++tx)
+        {
+            unsigned int tile = (y / tileSize) * grid.tilesX + tx;
+            unsigned int first = grid.representative[tile];
+            int row = y % tileSize;
+
+            grid.bounds(tile, x0, y0, x1, y1);
+
+            const uint8_t* sizes = &tileSizes[firstSize[first] + row * (x1 - x0)];
+            const unsigned int* rows = &tileRows[firstRow[first] + row];
+
+            memcpy(voronoiGraph.vertices + (*offset * 2), &tileVertices[rows[0] * 2], (rows[1] - rows[0]) * 2);
+
+            for(x = 0; x < x1 - x0; ++x, ++offset)
+            {
+                offset[1] = offset[0] + sizes[x];
+            }
+        }
+    }
+
+    numUniqueTiles = grid.numUnique;
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Celdas por tiles: " << grid.numUnique << " distintos de " << grid.representative.size());
+
+    return voronoiGraph;
+}
+
+//  Tramo de elementos [begin, end) de un array que se mueve shift posiciones.
+struct VoronoiRun
+{
+    unsigned int begin;
+    unsigned int end;
+    int shift;
+};
+
+//  Mueve los tramos de runs (en orden y con los destinos también en orden) dentro de data, con scale elementos por
+// posición: los que van hacia delante de último a primero y después los que van hacia atrás de primero a último. Así
+// ninguno pisa el origen de otro que todavía no se ha movido.
+template<typename T> static void moveVoronoiRuns(T* data, const std::vector<VoronoiRun>& runs, unsigned int scale = 1)
+{
+    for(unsigned int r = runs.size(); r-- > 0;)
+    {
+        if(runs[r].shift > 0)
+        {
+            std::copy_backward(data + runs[r].begin * scale, data + runs[r].end * scale,
+                               data + (runs[r].end + runs[r].shift) * scale);
+        }
+    }
+
+    for(unsigned int r = 0; r < runs.size(); ++r)
+    {
+        if(runs[r].shift < 0)
+        {
+            std::copy(data + runs[r].begin * scale, data + runs[r].end * scale,
+                      data + (runs[r].begin + runs[r].shift) * scale);
+        }
+    }
+}
+
+//  Saca otra vez de similarityGraph las celdas de los píxeles de cells (ordenados y sin repetir), en el mismo
+// voronoiGraph. Si todas tienen tantos vértices como antes se escriben en su sitio; si no, se desplazan las celdas que
+// van detrás de la primera que cambia, que caben porque la reserva es para el peor caso. En previousSizes quedan los
+// vértices que tenía cada celda de cells, para updateVoronoiMesh.
+void updateVoronoiGraph(VoronoiGraph& voronoiGraph, uint8_t* similarityGraph, const std::vector<unsigned int>& cells,
+                        std::vector<unsigned int>& previousSizes)
+{
+    int width = voronoiGraph.width;
+    int height = voronoiGraph.height;
+    unsigned int numPixels = width * height;
+    unsigned int numCells = cells.size();
+    unsigned int cellStride = VORONOI_MAX_CELL_VERTICES * 2 + 4;
+    std::vector<int8_t> extracted(numCells * cellStride);
+    std::vector<unsigned int> sizes(numCells);
+    std::vector<VoronoiRun> runs;
+    unsigned int* offsets = voronoiGraph.offsets;
+    unsigned int pixel, runEnd;
+    bool sameSizes = true;
+    int shift = 0;
+
+    previousSizes.resize(numCells);
+
+    for(unsigned int c = 0; c < numCells; ++c)
+    {
+        pixel = cells[c];
+        previousSizes[c] = offsets[pixel + 1] - offsets[pixel];
+        sizes[c] = extractVoronoiCell(similarityGraph + pixel, pixel % width, pixel / width, width, height,
+                                      &extracted[c * cellStride]);
+        sameSizes = sameSizes && sizes[c] == previousSizes[c];
+    }
+
+    //  Las celdas entre dos de cells se desplazan todas lo que han crecido las de cells anteriores.
+    if(!sameSizes)
+    {
+        for(unsigned int c = 0; c < numCells; ++c)
+        {
+            shift += (int)sizes[c] - (int)previousSizes[c];
+            runEnd = c + 1 < numCells ? cells[c + 1] : numPixels;
+
+            if(shift != 0 && cells[c] + 1 < runEnd)
+            {
+                VoronoiRun run = {offsets[cells[c] + 1], offsets[runEnd], shift};
+
+                runs.push_back(run);
+            }
+        }
+
+        moveVoronoiRuns(voronoiGraph.vertices, runs, 2);
+        shift = 0;
+
+        for(unsigned int c = 0; c < numCells; ++c)
+        {
+            shift += (int)sizes[c] - (int)previousSizes[c];
+            runEnd = c + 1 < numCells ? cells[c + 1] : numPixels;
+
+            for(pixel = cells[c] + 1; pixel <= runEnd && shift != 0; ++pixel)
+            {
+                offsets[pixel] += shift;
+            }
+        }
+    }
+
+    for(unsigned int c = 0; c < numCells; ++c)
+    {
+        memcpy(voronoiGraph.vertices + offsets[cells[c]] * 2, &extracted[c * cellStride], sizes[c] * 2);
+    }
+}
+
+void freeVoronoiGraph(VoronoiGraph& voronoiGraph)
+{
+    delete [] voronoiGraph.offsets;
+
+    voronoiGraph.offsets = 0;
+    voronoiGraph.vertices = 0;
+}
+
+//  Hueco (ver VORONOI_VERTEX_SLOTS) de un punto interior según los bits 1 de sus coordenadas: (1, 1), (3, 1), (1, 3),
+// (3, 3).
+static const uint8_t voronoiInnerSlots[4] = {1, 2, 4, 3};
+
+static inline uint32_t voronoiVertexId(int x, int y, int width)
+{
+    uint32_t slot = (x & 3) ? voronoiInnerSlots[((x & 2) >> 1) | (y & 2)] : 0;
+
+    return ((x >> 2) + (y >> 2) * (width + 1)) * VORONOI_VERTEX_SLOTS + slot;
+}
+
+//  Tabla hash de direccionamiento abierto (sondeo lineal) de los segmentos de las celdas, para emparejar cada
+// semisegmento con el de la celda vecina: guarda el primer semisegmento que aparece de cada segmento.
+struct EdgeEntry
+{
+    uint64_t key;           //  Los ids de sus dos vértices, el menor en la parte alta; 0 si la entrada está libre.
+    uint32_t halfEdge;
+};
+
+struct EdgeTable
+{
+    EdgeEntry* entries;
+    uint64_t mask;
+    unsigned int bits;
+};
+
+static void createEdgeTable(EdgeTable& table, unsigned int maxEdges)
+{
+    //  Al menos la mitad libre en el caso típico (cada segmento lo comparten dos celdas).
+    table.bits = 4;
+
+    while(((uint64_t)1 << table.bits) < (uint64_t)maxEdges + (maxEdges >> 1))
+    {
+        ++table.bits;
+    }
+
+    table.mask = ((uint64_t)1 << table.bits) - 1;
+    table.entries = new EdgeEntry[table.mask + 1];
+
+    memset(table.entries, 0, sizeof(EdgeEntry) * (table.mask + 1));
+}
+
+//  Devuelve el semisegmento que ya había con los mismos vértices, o VORONOI_NO_TWIN si es el primero (y lo guarda).
+static inline uint32_t findTwinEdge(EdgeTable& table, uint32_t firstId, uint32_t secondId, uint32_t halfEdge)
+{
+    //  Ningún segmento une un vértice consigo mismo, así que la clave nunca es 0 (el id 0 sólo puede ir en la parte alta).
+    uint64_t key = firstId < secondId ? ((uint64_t)firstId << 32) | secondId : ((uint64_t)secondId << 32) | firstId;
+    uint64_t i = (key * 0x9E3779B97F4A7C15ULL) >> (64 - table.bits);
+
+    while(table.entries[i].key != 0 && table.entries[i].key != key)
+    {
+        i = (i + 1) & table.mask;
+    }
+
+    if(table.entries[i].key == 0)
+    {
+        table.entries[i].key = key;
+        table.entries[i].halfEdge = halfEdge;
+
+        return VORONOI_NO_TWIN;
+    }
+
+    return table.entries[i].halfEdge;
+}
+
+//  Visibles: los que separan píxeles de distinto color y los que están sobre el borde de la imagen.
+static inline bool isVisibleEdge(const VoronoiMesh& voronoiMesh, uint32_t h)
+{
+    uint32_t twin = voronoiMesh.twins[h];
+    Point firstPoint = voronoiMesh.vertex(voronoiMesh.origins[h]);
+    Point secondPoint = voronoiMesh.vertex(voronoiMesh.origins[voronoiMesh.nexts[h]]);
+    int widthX4 = voronoiMesh.width << 2;
+    int heightX4 = voronoiMesh.height << 2;
+
+    return (twin != VORONOI_NO_TWIN && voronoiMesh.faceColors[voronoiMesh.faces[h]] != voronoiMesh.faceColors[voronoiMesh.faces[twin]])
+           || (firstPoint.first == 0 && secondPoint.first == 0)
+           || (firstPoint.second == 0 && secondPoint.second == 0)
+           || (firstPoint.first == widthX4 && secondPoint.first == widthX4)
+           || (firstPoint.second == heightX4 && secondPoint.second == heightX4);
+}
+
+//  spareHalfEdges deja sitio libre detrás de cada array, para que updateVoronoiMesh pueda hacer crecer las celdas sin
+// cambiar la reserva.
+VoronoiMesh buildVoronoiMesh(const VoronoiGraph& voronoiGraph, const uint32_t* pixels, int stride,
+                             unsigned int spareHalfEdges)
+{
+    VoronoiMesh voronoiMesh;
+    int width = voronoiGraph.width;
+    int height = voronoiGraph.height;
+    unsigned int numPixels = width * height;
+    unsigned int numHalfEdges = voronoiGraph.offsets[numPixels];
+    unsigned int capacity = numHalfEdges + spareHalfEdges;
+
+    //  Una sola reserva, como en el VoronoiGraph: los 4 arrays por semisegmento, los colores y detrás los visibles.
+    voronoiMesh.width = width;
+    voronoiMesh.height = height;
+    voronoiMesh.numVertices = (width + 1) * (height + 1) * VORONOI_VERTEX_SLOTS;
+    voronoiMesh.numHalfEdges = numHalfEdges;
+    voronoiMesh.origins = new uint32_t[capacity * 4 + numPixels + (capacity + 3) / 4];
+    voronoiMesh.twins = voronoiMesh.origins + capacity;
+    voronoiMesh.nexts = voronoiMesh.twins + capacity;
+    voronoiMesh.faces = voronoiMesh.nexts + capacity;
+    voronoiMesh.faceColors = voronoiMesh.faces + capacity;
+    voronoiMesh.visible = (uint8_t*)(voronoiMesh.faceColors + numPixels);
+
+    int x, y;
+    unsigned int pixel, begin, end, h, twin;
+    VoronoiCell voronoiCell;
+    const uint32_t* img;
+    int dx, dy;
+    unsigned int numVisibleEdges = 0;
+
+    EdgeTable edges;
+
+    createEdgeTable(edges, numHalfEdges);
+
+    for(y = 0; y < height; ++y)
+    {
+        dy = y << 2;
+        img = (const uint32_t*)((const unsigned char*)pixels + y * stride);
+
+        for(x = 0; x < width; ++x)
+        {
+            dx = x << 2;
+            pixel = x + y * width;
+            begin = voronoiGraph.offsets[pixel];
+            end = voronoiGraph.offsets[pixel + 1];
+
+            voronoiCell = voronoiGraph.cell(x, y);
+            voronoiMesh.faceColors[pixel] = img[x];
+
+            for(h = begin; h < end; ++h)
+            {
+                voronoiMesh.origins[h] = voronoiVertexId(voronoiCell.vertex(h - begin).first + dx,
+                                                         voronoiCell.vertex(h - begin).second + dy, width);
+                voronoiMesh.nexts[h] = h + 1 < end ? h + 1 : begin;
+                voronoiMesh.faces[h] = pixel;
+            }
+
+            //  El segmento ya estaba si lo ha puesto la celda vecina: son gemelos.
+            for(h = begin; h < end; ++h)
+            {
+                twin = findTwinEdge(edges, voronoiMesh.origins[h], voronoiMesh.origins[voronoiMesh.nexts[h]], h);
+                voronoiMesh.twins[h] = twin;
+
+                if(twin != VORONOI_NO_TWIN)
+                {
+                    voronoiMesh.twins[twin] = h;
+                }
+            }
+        }
+    }
+
+    delete [] edges.entries;
+
+    for(h = 0; h < numHalfEdges; ++h)
+    {
+        twin = voronoiMesh.twins[h];
+        voronoiMesh.visible[h] = isVisibleEdge(voronoiMesh, h);
+
+        numVisibleEdges += voronoiMesh.visible[h] && (twin == VORONOI_NO_TWIN || h < twin);
+    }
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_STAGES, "Numero segmentos extraidos:" << numVisibleEdges);
+
+    return voronoiMesh;
+}
+
+void freeVoronoiMesh(VoronoiMesh& voronoiMesh)
+{
+    delete [] voronoiMesh.origins;
+
+    voronoiMesh.origins = 0;
+    voronoiMesh.twins = 0;
+    voronoiMesh.nexts = 0;
+    voronoiMesh.faces = 0;
+    voronoiMesh.faceColors = 0;
+    voronoiMesh.visible = 0;
+}
+
+//  Cada segmento visible una sola vez: el semisegmento sin gemelo o el menor de los dos.
+static void collectVisibleEdges(const VoronoiMesh& voronoiMesh, std::vector<uint32_t>& visibleEdges)
+{
+    visibleEdges.clear();
+
+    for(uint32_t h = 0; h < voronoiMesh.numHalfEdges; ++h)
+    {
+        if(voronoiMesh.visible[h] && (voronoiMesh.twins[h] == VORONOI_NO_TWIN || h < voronoiMesh.twins[h]))
+        {
+            visibleEdges.push_back(h);
+        }
+    }
+}
+
+std::set<Edge> extractSpLines(const VoronoiMesh& voronoiMesh)
+{
+    std::set<Edge> visibleEdges = extractVisibleEdges(voronoiMesh);
+
+    std::list<Polygon> curves;
+
+    for(std::set<Edge>::iterator it = visibleEdges.begin(); it != visibleEdges.end(); ++it)
+    {
+
+    }
+
+
+    return visibleEdges;
+}
+
+std::set<Edge> extractVisibleEdges(const VoronoiMesh& voronoiMesh)
+{
+    std::vector<uint32_t> edges;
+    std::set<Edge> visibleEdges;
+    Point firstPoint, secondPoint;
+
+    collectVisibleEdges(voronoiMesh, edges);
+
+    for(size_t e = 0; e < edges.size(); ++e)
+    {
+        firstPoint = voronoiMesh.vertex(voronoiMesh.origins[edges[e]]);
+        secondPoint = voronoiMesh.vertex(voronoiMesh.origins[voronoiMesh.nexts[edges[e]]]);
+
+        //  Los segmentos se dan con el punto menor (por x y luego por y) primero.
+        if(secondPoint < firstPoint)
+        {
+            visibleEdges.insert(std::make_pair(secondPoint, firstPoint));
+        }
+        else
+        {
+            visibleEdges.insert(std::make_pair(firstPoint, secondPoint));
+        }
+    }
+
+    return visibleEdges;
+}
+
+//  Segmentos visibles de cada vértice, por id: los de vertex son [offsets[vertex], offsets[vertex + 1]) de
+// neighbours (el otro vértice) y edges (el índice del segmento).
+struct VertexAdjacency
+{
+    uint32_t* offsets;
+    uint32_t* neighbours;
+    uint32_t* edges;
+};
+
+static void buildVertexAdjacency(VertexAdjacency& adjacency, const VoronoiMesh& voronoiMesh,
+                                 const std::vector<uint32_t>& visibleEdges)
+{
+    uint32_t first, second;
+    uint32_t numVertices = voronoiMesh.numVertices;
+
+    adjacency.offsets = new uint32_t[numVertices + 1];
+    adjacency.neighbours = new uint32_t[visibleEdges.size() * 2];
+    adjacency.edges = new uint32_t[visibleEdges.size() * 2];
+
+    memset(adjacency.offsets, 0, sizeof(uint32_t) * (numVertices + 1));
+
+    for(size_t e = 0; e < visibleEdges.size(); ++e)
+    {
+        ++adjacency.offsets[voronoiMesh.origins[visibleEdges[e]] + 1];
+        ++adjacency.offsets[voronoiMesh.origins[voronoiMesh.nexts[visibleEdges[e]]] + 1];
+    }
+
+    for(uint32_t v = 0; v < numVertices; ++v)
+    {
+        adjacency.offsets[v + 1] += adjacency.offsets[v];
+    }
+
+    //  Se rellena usando offsets[v] como cursor, y al acabar offsets[v] ha llegado al inicio de v + 1: se
+    // recoloca desplazando todo una posición.
+    for(size_t e = 0; e < visibleEdges.size(); ++e)
+    {
+        first = voronoiMesh.origins[visibleEdges[e]];
+        second = voronoiMesh.origins[voronoiMesh.nexts[visibleEdges[e]]];
+
+        adjacency.neighbours[adjacency.offsets[first]] = second;
+        adjacency.edges[adjacency.offsets[first]++] = e;
+        adjacency.neighbours[adjacency.offsets[second]] = first;
+        adjacency.edges[adjacency.offsets[second]++] = e;
+    }
+
+    memmove(adjacency.offsets + 1, adjacency.offsets, sizeof(uint32_t) * numVertices);
+    adjacency.offsets[0] = 0;
+}
+
+static void freeVertexAdjacency(VertexAdjacency& adjacency)
+{
+    delete [] adjacency.offsets;
+    delete [] adjacency.neighbours;
+    delete [] adjacency.edges;
+}
+
+static inline bool isEdgeSet(const uint64_t* edges, uint32_t edge)
+{
+    return (edges[edge >> 6] >> (edge & 63)) & 1;
+}
+
+//  Una curva acaba en los vértices que no son de dos segmentos (un extremo o un cruce de curvas) y, si sólo se juntan
+// los segmentos de edgesOwned, en los que tienen uno dentro y otro fuera (una costura con otra banda).
+static inline bool isCurveEnd(const VertexAdjacency& adjacency, const uint64_t* edgesOwned, uint32_t vertex)
+{
+    uint32_t slot = adjacency.offsets[vertex];
+
+    return adjacency.offsets[vertex + 1] - slot != 2 ||
+           (edgesOwned && isEdgeSet(edgesOwned, adjacency.edges[slot]) != isEdgeSet(edgesOwned, adjacency.edges[slot + 1]));
+}
+
+//  Añade a curves la curva que sale de vertex por el segmento del hueco slot de su adyacencia, siguiéndola hasta el
+// siguiente final de curva o, si es un lazo, hasta volver a vertex.
+static void followCurve(const VoronoiMesh& voronoiMesh, const VertexAdjacency& adjacency, uint64_t* edgesUsed,
+                        const uint64_t* edgesOwned, uint32_t vertex, uint32_t slot, CurveList& curves)
+{
+    uint32_t start = vertex;
+    uint32_t edge;
+
+    curves.vertices.push_back(voronoiMesh.vertex(vertex));
+
+    for(;;)
+    {
+        edge = adjacency.edges[slot];
+        edgesUsed[edge >> 6] |= (uint64_t)1 << (edge & 63);
+        vertex = adjacency.neighbours[slot];
+        curves.vertices.push_back(voronoiMesh.vertex(vertex));
+
+        if(vertex == start || isCurveEnd(adjacency, edgesOwned, vertex))
+        {
+            break;
+        }
+
+        //  Se sale por el otro segmento del vértice.
+        slot = adjacency.offsets[vertex];
+
+        if(adjacency.edges[slot] == edge)
+        {
+            ++slot;
+        }
+    }
+
+    curves.offsets.push_back(curves.vertices.size());
+
+    DEPIXEL_TRACE(DEPIXEL_TRACE_DETAIL, "Curva desde (" << voronoiMesh.vertex(start).first << ", " << voronoiMesh.vertex(start).second << "): " << curves.curveSize(curves.size() - 1) << " vertices");
+}
+
+//  Junta los segmentos visibles (sólo los de edgesOwned si no es 0) en curvas, recorriendo cada uno una sola vez:
+// primero las que van de un final de curva al siguiente, y lo que queda al final son lazos cerrados.
+static void chainCurves(const VoronoiMesh& voronoiMesh, const std::vector<uint32_t>& visibleEdges,
+                        const VertexAdjacency& adjacency, const uint64_t* edgesOwned, CurveList& curves)
+{
+    uint32_t vertex, slot, edge;
+
+    //  Un bit por segmento visible.
+    std::vector<uint64_t> edgesUsed((visibleEdges.size() + 63) >> 6, 0);
+
+    curves.offsets.push_back(0);
+
+    for(vertex = 0; vertex < voronoiMesh.numVertices; ++vertex)
+    {
+        if(!isCurveEnd(adjacency, edgesOwned, vertex))
+        {
+            continue;
+        }
+
+        for(slot = adjacency.offsets[vertex]; slot < adjacency.offsets[vertex + 1]; ++slot)
+        {
+            edge = adjacency.edges[slot];
+
+            if(!isEdgeSet(edgesUsed.data(), edge) && (!edgesOwned || isEdgeSet(edgesOwned, edge)))
+            {
+                followCurve(voronoiMesh, adjacency, edgesUsed.data(), edgesOwned, vertex, slot, curves);
+            }
+        }
+    }
+
+    for(edge = 0; edge < visibleEdges.size(); ++edge)
+    {
+        if(!isEdgeSet(edgesUsed.data(), edge) && (!edgesOwned || isEdgeSet(edgesOwned, edge)))
+        {
+            vertex = voronoiMesh.origins[visibleEdges[edge]];
+            slot = adjacency.offsets[vertex];
+
+            if(adjacency.edges[slot] != edge)
+            {
+                ++slot;
+            }
+
+            followCurve(voronoiMesh, adjacency, edgesUsed.data(), edgesOwned, vertex, slot, curves);
+        }
+    }
+}
+
+CurveList extractCurves(const VoronoiMesh& voronoiMesh)
+{
+    CurveList curves;
+
+    std::vector<uint32_t> visibleEdges;
+    VertexAdjacency adjacency;
+
+    collectVisibleEdges(voronoiMesh, visibleEdges);
+    buildVertexAdjacency(adjacency, voronoiMesh, visibleEdges);
+
+    chainCurves(voronoiMesh, visibleEdges, adjacency, 0, curves);
+
+    freeVertexAdjacency(adjacency);
+
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_VISIBLE_EDGES, visibleEdges.size());
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_CURVES, curves.size());
+
+    return curves;
+}
+
+//  Curvas de los segmentos de las filas [rowBegin, rowEnd) de la malla: cada segmento es de la fila más alta de las
+// dos celdas que separa, así que las filas vecinas (la de antes y la de después) tienen que estar en la malla para
+// que los segmentos y las valencias de los vértices del límite sean los de la imagen completa. Las curvas que siguen
+// en otra banda acaban en el vértice de la costura, y seamEnds dice por cada curva si su primer vértice (bit 0x01) o
+// su último vértice (bit 0x02) son de costura.
+CurveList extractCurves(const VoronoiMesh& voronoiMesh, int rowBegin, int rowEnd, std::vector<uint8_t>& seamEnds)
+{
+    CurveList curves;
+
+    std::vector<uint32_t> visibleEdges;
+    VertexAdjacency adjacency;
+    uint32_t h, twin;
+    int row;
+
+    collectVisibleEdges(voronoiMesh, visibleEdges);
+    buildVertexAdjacency(adjacency, voronoiMesh, visibleEdges);
+
+    std::vector<uint64_t> edgesOwned((visibleEdges.size() + 63) >> 6, 0);
+    size_t numEdgesOwned = 0;
+
+    for(uint32_t edge = 0; edge < visibleEdges.size(); ++edge)
+    {
+        h = visibleEdges[edge];
+        twin = voronoiMesh.twins[h];
+        row = voronoiMesh.faces[h] / voronoiMesh.width;
+
+        if(twin != VORONOI_NO_TWIN && (int)(voronoiMesh.faces[twin] / voronoiMesh.width) < row)
+        {
+            row = voronoiMesh.faces[twin] / voronoiMesh.width;
+        }
+
+        if(row >= rowBegin && row < rowEnd)
+        {
+            edgesOwned[edge >> 6] |= (uint64_t)1 << (edge & 63);
+            ++numEdgesOwned;
+        }
+    }
+
+    chainCurves(voronoiMesh, visibleEdges, adjacency, edgesOwned.data(), curves);
+
+    seamEnds.assign(curves.size(), 0);
+
+    //  Los extremos de costura son los de dos segmentos (los demás acaban la curva en cualquier banda). Los lazos
+    // cerrados no tienen extremos.
+    for(unsigned int i = 0; i < curves.size(); ++i)
+    {
+        const Point& first = curves.curve(i)[0];
+        const Point& last = curves.curve(i)[curves.curveSize(i) - 1];
+        uint32_t firstId = voronoiVertexId(first.first, first.second, voronoiMesh.width);
+        uint32_t lastId = voronoiVertexId(last.first, last.second, voronoiMesh.width);
+
+        if(firstId != lastId)
+        {
+            seamEnds[i] = (adjacency.offsets[firstId + 1] - adjacency.offsets[firstId] == 2 ? 0x01 : 0) |
+                          (adjacency.offsets[lastId + 1] - adjacency.offsets[lastId] == 2 ? 0x02 : 0);
+        }
+    }
+
+    freeVertexAdjacency(adjacency);
+
+    //  Las curvas las cuenta depixelBanded al juntar los trozos.
+    DEPIXEL_COUNT(DEPIXEL_COUNTER_VISIBLE_EDGES, numEdgesOwned);
+
+    return curves;
+}
+
+//  Semisegmento de una celda vecina de pixel (las 8 de alrededor) que va de second a first, o VORONOI_NO_TWIN.
+static uint32_t findNeighbourTwin(const VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph, unsigned int pixel,
+                                  uint32_t first, uint32_t second)
+{
+    int width = voronoiGraph.width;
+    int x = pixel % width;
+    int y = pixel / width;
+
+    for(int ny = std::max(0, y - 1); ny <= std::min(voronoiGraph.height - 1, y + 1); ++ny)
+    {
+        for(int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx)
+        {
+            unsigned int neighbour = nx + ny * width;
+
+            if(neighbour == pixel)
+            {
+                continue;
+            }
+
+            for(uint32_t h = voronoiGraph.offsets[neighbour]; h < voronoiGraph.offsets[neighbour + 1]; ++h)
+            {
+                if(voronoiMesh.origins[h] == second && voronoiMesh.origins[voronoiMesh.nexts[h]] == first)
+                {
+                    return h;
+                }
+            }
+        }
+    }
+
+    return VORONOI_NO_TWIN;
+}
+
+//  Semisegmentos que caben en cada array de voronoiMesh (ver el spareHalfEdges de buildVoronoiMesh).
+static inline unsigned int voronoiMeshCapacity(const VoronoiMesh& voronoiMesh)
+{
+    return voronoiMesh.twins - voronoiMesh.origins;
+}
+
+//  Cambia la reserva de voronoiMesh por una con sitio para capacity semisegmentos por array, con lo que tenía.
+static void reserveVoronoiMesh(VoronoiMesh& voronoiMesh, unsigned int capacity)
+{
+    unsigned int numPixels = voronoiMesh.width * voronoiMesh.height;
+    unsigned int numHalfEdges = voronoiMesh.numHalfEdges;
+    uint32_t* origins = new uint32_t[capacity * 4 + numPixels + (capacity + 3) / 4];
+
+    memcpy(origins, voronoiMesh.origins, sizeof(uint32_t) * numHalfEdges);
+    memcpy(origins + capacity, voronoiMesh.twins, sizeof(uint32_t) * numHalfEdges);
+    memcpy(origins + capacity * 2, voronoiMesh.nexts, sizeof(uint32_t) * numHalfEdges);
+    memcpy(origins + capacity * 3, voronoiMesh.faces, sizeof(uint32_t) * numHalfEdges);
+    memcpy(origins + capacity * 4, voronoiMesh.faceColors, sizeof(uint32_t) * numPixels);
+    memcpy(origins + capacity * 4 + numPixels, voronoiMesh.visible, numHalfEdges);
+
+    delete [] voronoiMesh.origins;
+
+    voronoiMesh.origins = origins;
+    voronoiMesh.twins = origins + capacity;
+    voronoiMesh.nexts = voronoiMesh.twins + capacity;
+    voronoiMesh.faces = voronoiMesh.nexts + capacity;
+    voronoiMesh.faceColors = voronoiMesh.faces + capacity;
+    voronoiMesh.visible = (uint8_t*)(voronoiMesh.faceColors + numPixels);
+}
+
+//  Lo que se ha desplazado el semisegmento que estaba en h, según los tramos de runs (con su posición de antes). Los
+// que estaban antes del primer tramo no se mueven.
+static inline int voronoiRunShift(const std::vector<VoronoiRun>& runs, uint32_t h)
+{
+    if(runs.empty() || h < runs.front().begin)
+    {
+        return 0;
+    }
+
+    if(h >= runs.back().begin)
+    {
+        return runs.back().shift;
+    }
+
+    unsigned int low = 0;
+    unsigned int high = runs.size() - 1;
+
+    while(low + 1 < high)
+    {
+        unsigned int middle = (low + high) / 2;
+
+        if(h < runs[middle].begin)
+        {
+            high = middle;
+        }
+        else
+        {
+            low = middle;
+        }
+    }
+
+    return runs[low].shift;
+}
+
+//  Rehace en voronoiMesh, la malla del diagrama de antes, las celdas de cells (ordenados y sin repetir) que
+// updateVoronoiGraph acaba de sacar otra vez en voronoiGraph; previousSizes son los vértices que tenían. Si todas
+// tienen los mismos, sólo se tocan esas celdas; si no, se desplazan también los semisegmentos de detrás y se corrigen
+// sus nexts y los twins que llegan a ellos. Las celdas vecinas de cells se añaden a cells, porque cambian sus gemelos;
+// todas se rehacen a partir de pixels, buscando los gemelos entre sus vecinas en lugar de en una tabla de toda la
+// imagen.
+void updateVoronoiMesh(VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph,
+                       const std::vector<unsigned int>& previousSizes, const uint32_t* pixels, int stride,
+                       std::vector<unsigned int>& cells)
+{
+    int width = voronoiGraph.width;
+    int height = voronoiGraph.height;
+    unsigned int numPixels = width * height;
+    unsigned int numHalfEdges = voronoiGraph.offsets[numPixels];
+    unsigned int numCells = cells.size();
+    const unsigned int* offsets = voronoiGraph.offsets;
+    std::vector<VoronoiRun> runs;
+    bool sameSizes = true;
+    int x, y, nx, ny;
+    uint32_t h, twin;
+
+    for(unsigned int c = 0; c < numCells; ++c)
+    {
+        sameSizes = sameSizes && offsets[cells[c] + 1] - offsets[cells[c]] == previousSizes[c];
+    }
+
+    if(!sameSizes)
+    {
+        //  Los tramos entre dos celdas de cells, con su posición de antes, y hasta dónde se mueve algo.
+        unsigned int runEnd;
+        unsigned int movedEnd = 0;
+        int shift = 0;
+
+        for(unsigned int c = 0; c < numCells; ++c)
+        {
+            shift += (int)(offsets[cells[c] + 1] - offsets[cells[c]]) - (int)previousSizes[c];
+            runEnd = c + 1 < numCells ? cells[c + 1] : numPixels;
+
+            if(cells[c] + 1 < runEnd)
+            {
+                VoronoiRun run = {offsets[cells[c] + 1] - shift, offsets[runEnd] - shift, shift};
+
+                runs.push_back(run);
+            }
+
+            if(shift != 0)
+            {
+                movedEnd = runEnd;
+            }
+        }
+
+        if(numHalfEdges > voronoiMeshCapacity(voronoiMesh))
+        {
+            reserveVoronoiMesh(voronoiMesh, numHalfEdges + numHalfEdges / 16);
+        }
+
+        moveVoronoiRuns(voronoiMesh.origins, runs);
+        moveVoronoiRuns(voronoiMesh.twins, runs);
+        moveVoronoiRuns(voronoiMesh.nexts, runs);
+        moveVoronoiRuns(voronoiMesh.faces, runs);
+        moveVoronoiRuns(voronoiMesh.visible, runs);
+
+        for(unsigned int r = 0; r < runs.size(); ++r)
+        {
+            if(runs[r].shift == 0)
+            {
+                continue;
+            }
+
+            for(h = runs[r].begin + runs[r].shift; h < runs[r].end + runs[r].shift; ++h)
+            {
+                voronoiMesh.nexts[h] += runs[r].shift;
+            }
+        }
+
+        //  Los gemelos están en una celda vecina: sólo pueden haberse movido los de una fila antes de la primera celda
+        // de cells hasta una fila después de lo movido. Los de las celdas de cells y sus vecinas se buscan después otra
+        // vez.
+        unsigned int twinsEnd = offsets[std::min(numPixels, movedEnd + width + 1)];
+
+        for(h = offsets[std::max(0, (int)cells[0] - width - 1)]; h < twinsEnd; ++h)
+        {
+            twin = voronoiMesh.twins[h];
+
+            if(twin != VORONOI_NO_TWIN)
+            {
+                voronoiMesh.twins[h] = twin + voronoiRunShift(runs, twin);
+            }
+        }
+
+        voronoiMesh.numHalfEdges = numHalfEdges;
+    }
+
+    for(unsigned int c = 0; c < numCells; ++c)
+    {
+        x = cells[c] % width;
+        y = cells[c] / width;
+
+        for(ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny)
+        {
+            for(nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx)
+            {
+                cells.push_back(nx + ny * width);
+            }
+        }
+    }
+
+    std::sort(cells.begin(), cells.end());
+    cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+    for(unsigned int c = 0; c < cells.size(); ++c)
+    {
+        unsigned int pixel = cells[c];
+        unsigned int begin = offsets[pixel];
+        unsigned int end = offsets[pixel + 1];
+        VoronoiCell voronoiCell = voronoiGraph.cell(pixel % width, pixel / width);
+        int dx = (pixel % width) << 2;
+        int dy = (pixel / width) << 2;
+
+        voronoiMesh.faceColors[pixel] = *(const uint32_t*)((const unsigned char*)pixels + (pixel / width) * stride + (pixel % width) * sizeof(uint32_t));
+
+        for(h = begin; h < end; ++h)
+        {
+            voronoiMesh.origins[h] = voronoiVertexId(voronoiCell.vertex(h - begin).first + dx,
+                                                     voronoiCell.vertex(h - begin).second + dy, width);
+            voronoiMesh.nexts[h] = h + 1 < end ? h + 1 : begin;
+            voronoiMesh.faces[h] = pixel;
+        }
+    }
+
+    //  Con todos los orígenes ya puestos, los gemelos y la visibilidad de las celdas de cells.
+    for(unsigned int c = 0; c < cells.size(); ++c)
+    {
+        for(h = offsets[cells[c]]; h < offsets[cells[c] + 1]; ++h)
+        {
+            voronoiMesh.twins[h] = findNeighbourTwin(voronoiMesh, voronoiGraph, cells[c], voronoiMesh.origins[h],
+                                                     voronoiMesh.origins[voronoiMesh.nexts[h]]);
+        }
+    }
+
+    for(unsigned int c = 0; c < cells.size(); ++c)
+    {
+        for(h = offsets[cells[c]]; h < offsets[cells[c] + 1]; ++h)
+        {
+            voronoiMesh.visible[h] = isVisibleEdge(voronoiMesh, h);
+        }
+    }
+}
+
+//  Segmentos visibles que llegan a vertex, cada uno por su representante (el semisegmento sin gemelo o el menor de los
+// dos, como en collectVisibleEdges) y de menor a mayor. Un vértice está en la esquina de su id o dentro de su píxel,
+// así que basta mirar las celdas de los 3x3 píxeles de alrededor.
+static unsigned int vertexEdges(const VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph, uint32_t vertex,
+                                uint32_t* edges, unsigned int maxEdges)
+{
+    int width = voronoiGraph.width;
+    int x = (vertex / VORONOI_VERTEX_SLOTS) % (width + 1);
+    int y = (vertex / VORONOI_VERTEX_SLOTS) / (width + 1);
+    unsigned int numEdges = 0;
+    uint32_t h, twin, edge;
+
+    for(int ny = std::max(0, y - 1); ny <= std::min(voronoiGraph.height - 1, y + 1); ++ny)
+    {
+        for(int nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx)
+        {
+            unsigned int pixel = nx + ny * width;
+
+            for(h = voronoiGraph.offsets[pixel]; h < voronoiGraph.offsets[pixel + 1]; ++h)
+            {
+                if(!voronoiMesh.visible[h] ||
+                   (voronoiMesh.origins[h] != vertex && voronoiMesh.origins[voronoiMesh.nexts[h]] != vertex))
+                {
+                    continue;
+                }
+
+                twin = voronoiMesh.twins[h];
+                edge = twin == VORONOI_NO_TWIN || h < twin ? h : twin;
+
+                if(std::find(edges, edges + numEdges, edge) == edges + numEdges && numEdges < maxEdges)
+                {
+                    edges[numEdges++] = edge;
+                }
+            }
+        }
+    }
+
+    std::sort(edges, edges + numEdges);
+
+    return numEdges;
+}
+
+static inline uint32_t otherEndpoint(const VoronoiMesh& voronoiMesh, uint32_t edge, uint32_t vertex)
+{
+    uint32_t first = voronoiMesh.origins[edge];
+
+    return first == vertex ? voronoiMesh.origins[voronoiMesh.nexts[edge]] : first;
+}
+
+//  Sigue la curva desde vertex por edge hasta un final de curva o hasta volver a stop, añadiendo a vertices y edges
+// los vértices (sin vertex) y los segmentos recorridos. Devuelve true si ha vuelto a stop sin pasar por un final.
+static bool walkCurve(const VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph, uint32_t vertex, uint32_t edge,
+                      uint32_t stop, std::vector<uint32_t>& vertices, std::vector<uint32_t>& edges)
+{
+    uint32_t adjacent[8];
+
+    for(;;)
+    {
+        edges.push_back(edge);
+        vertex = otherEndpoint(voronoiMesh, edge, vertex);
+        vertices.push_back(vertex);
+
+        if(vertexEdges(voronoiMesh, voronoiGraph, vertex, adjacent, 8) != 2)
+        {
+            return false;
+        }
+
+        if(vertex == stop)
+        {
+            return true;
+        }
+
+        edge = adjacent[0] == edge ? adjacent[1] : adjacent[0];
+    }
+}
+
+//  Añade la curva i de curves a las listas de sus vértices en index. Un vértice que se repite en la curva (el final de
+// las cerradas) queda dos veces en su lista.
+static void indexCurve(CurveIndex& index, const CurveList& curves, unsigned int i, int width)
+{
+    for(unsigned int v = curves.offsets[i]; v < curves.offsets[i + 1]; ++v)
+    {
+        uint32_t vertex = voronoiVertexId(curves.vertices[v].first, curves.vertices[v].second, width);
+        uint32_t entry = index.freeEntries;
+
+        if(entry == CURVE_INDEX_END)
+        {
+            entry = index.entries.size();
+            index.entries.push_back(CurveIndexEntry());
+        }
+        else
+        {
+            index.freeEntries = index.entries[entry].next;
+        }
+
+        index.entries[entry].curve = i;
+        index.entries[entry].next = index.first[vertex];
+        index.first[vertex] = entry;
+    }
+}
+
+//  Cambia la curva i por la curva to en las listas de sus vértices, o la quita de ellas si to es CURVE_INDEX_END.
+static void reindexCurve(CurveIndex& index, const CurveList& curves, unsigned int i, unsigned int to, int width)
+{
+    for(unsigned int v = curves.offsets[i]; v < curves.offsets[i + 1]; ++v)
+    {
+        uint32_t* link = &index.first[voronoiVertexId(curves.vertices[v].first, curves.vertices[v].second, width)];
+
+        while(*link != CURVE_INDEX_END)
+        {
+            CurveIndexEntry& entry = index.entries[*link];
+            uint32_t removed = *link;
+
+            if(entry.curve != i || to != CURVE_INDEX_END)
+            {
+                entry.curve = entry.curve == i ? to : entry.curve;
+                link = &entry.next;
+                continue;
+            }
+
+            *link = entry.next;
+            entry.next = index.freeEntries;
+            index.freeEntries = removed;
+        }
+    }
+}
+
+void buildCurveIndex(CurveIndex& index, const CurveList& curves, const VoronoiMesh& voronoiMesh)
+{
+    index.first.assign(voronoiMesh.numVertices, CURVE_INDEX_END);
+    index.entries.clear();
+    index.entries.reserve(curves.vertices.size());
+    index.freeEntries = CURVE_INDEX_END;
+
+    for(unsigned int i = 0; i < curves.size(); ++i)
+    {
+        indexCurve(index, curves, i, voronoiMesh.width);
+    }
+}
+
+//  Rehace las curvas que pasan por las celdas de cells (las que ha rehecho updateVoronoiMesh) de la malla de
+// voronoiGraph; index es el de curves (buildCurveIndex) y queda al día. Las curvas que no tocan ningún vértice de esas
+// celdas (ni de cómo eran antes) no cambian; las demás se quitan, sus huecos se llenan con las últimas de la lista, y
+// se añaden al final las de la malla nueva, empezando en el mismo vértice y en el mismo sentido que en extractCurves.
+// El resultado tiene las mismas curvas que extractCurves sobre la malla nueva, aunque no en el mismo orden.
+void updateCurves(CurveList& curves, CurveIndex& index, const VoronoiMesh& voronoiMesh, const VoronoiGraph& voronoiGraph,
+                  const std::vector<unsigned int>& cells, unsigned int& numRemoved, unsigned int& numAdded)
+{
+    int width = voronoiGraph.width;
+    int height = voronoiGraph.height;
+    std::vector<uint32_t> touched;
+    std::vector<unsigned int> removed;
+    int x, y, nx, ny;
+
+    //  Los vértices de una celda, tenga la forma que tenga, son esquinas de su píxel o puntos interiores de él o de sus
+    // 8 vecinos: así están también los de la celda de antes, que ya no está en voronoiGraph.
+    for(unsigned int c = 0; c < cells.size(); ++c)
+    {
+        x = cells[c] % width;
+        y = cells[c] / width;
+
+        for(ny = y; ny <= y + 1; ++ny)
+        {
+            for(nx = x; nx <= x + 1; ++nx)
+            {
+                touched.push_back((nx + ny * (width + 1)) * VORONOI_VERTEX_SLOTS);
+            }
+        }
+
+        for(ny = std::max(0, y - 1); ny <= std::min(height - 1, y + 1); ++ny)
+        {
+            for(nx = std::max(0, x - 1); nx <= std::min(width - 1, x + 1); ++nx)
+            {
+                for(uint32_t slot = 1; slot < VORONOI_VERTEX_SLOTS; ++slot)
+                {
+                    touched.push_back((nx + ny * (width + 1)) * VORONOI_VERTEX_SLOTS + slot);
+                }
+            }
+        }
+    }
+
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+
+    for(unsigned int t = 0; t < touched.size(); ++t)
+    {
+        for(uint32_t entry = index.first[touched[t]]; entry != CURVE_INDEX_END; entry = index.entries[entry].next)
+        {
+            removed.push_back(index.entries[entry].curve);
+        }
+    }
+
+    std::sort(removed.begin(), removed.end());
+    removed.erase(std::unique(removed.begin(), removed.end()), removed.end());
+
+    numRemoved = removed.size();
+    numAdded = 0;
+
+    if(curves.offsets.empty())
+    {
+        curves.offsets.push_back(0);
+    }
+
+    //  Los huecos de las quitadas se llenan con las últimas curvas que se quedan, así que sólo cambian de índice éstas.
+    // Las de entre dos huecos se desplazan en vertices lo que ocupan de más o de menos las que llenan los huecos de
+    // antes.
+    unsigned int numKept = curves.size() - numRemoved;
+    std::vector<unsigned int> fillerSizes;
+    std::vector<Point> fillerVertices;
+    std::vector<VoronoiRun> runs;
+    unsigned int numHoles = 0;
+    int shift = 0;
+
+    for(unsigned int r = 0; r < numRemoved; ++r)
+    {
+        reindexCurve(index, curves, removed[r], CURVE_INDEX_END, width);
+        numHoles += removed[r] < numKept;
+    }
+
+    for(unsigned int i = numKept; i < curves.size(); ++i)
+    {
+        if(!std::binary_search(removed.begin(), removed.end(), i))
+        {
+            reindexCurve(index, curves, i, removed[fillerSizes.size()], width);
+            fillerVertices.insert(fillerVertices.end(), curves.vertices.begin() + curves.offsets[i],
+                                  curves.vertices.begin() + curves.offsets[i + 1]);
+            fillerSizes.push_back(curves.curveSize(i));
+        }
+    }
+
+    for(unsigned int r = 0; r < numHoles; ++r)
+    {
+        unsigned int hole = removed[r];
+        unsigned int runEnd = r + 1 < numHoles ? removed[r + 1] : numKept;
+
+        shift += (int)fillerSizes[r] - (int)curves.curveSize(hole);
+
+        if(hole + 1 < runEnd)
+        {
+            VoronoiRun run = {curves.offsets[hole + 1], curves.offsets[runEnd], shift};
+
+            runs.push_back(run);
+        }
+    }
+
+    moveVoronoiRuns(curves.vertices.data(), runs);
+
+    if(numHoles > 0)
+    {
+        unsigned int filler = 0;
+        unsigned int fillerBegin = 0;
+        unsigned int begin = curves.offsets[removed[0]];
+
+        for(unsigned int i = removed[0]; i < numKept; ++i)
+        {
+            unsigned int end = curves.offsets[i + 1];
+
+            if(filler < numHoles && removed[filler] == i)
+            {
+                unsigned int size = fillerSizes[filler];
+
+                std::copy(fillerVertices.begin() + fillerBegin, fillerVertices.begin() + fillerBegin + size,
+                          curves.vertices.begin() + curves.offsets[i]);
+                fillerBegin += size;
+                ++filler;
+                curves.offsets[i + 1] = curves.offsets[i] + size;
+            }
+            else
+            {
+                curves.offsets[i + 1] = curves.offsets[i] + end - begin;
+            }
+
+            begin = end;
+        }
+    }
+
+    curves.vertices.resize(curves.offsets[numKept]);
+    curves.offsets.resize(numKept + 1);
+
+    //  Y se sacan de la malla nueva las curvas de los segmentos visibles de los vértices de touched.
+    std::unordered_set<uint32_t> used;
+    std::vector<uint32_t> forward, forwardEdges, backward, backwardEdges;
+    uint32_t adjacent[8];
+    unsigned int numAdjacent;
+
+    for(unsigned int t = 0; t < touched.size(); ++t)
+    {
+        numAdjacent = vertexEdges(voronoiMesh, voronoiGraph, touched[t], adjacent, 8);
+
+        for(unsigned int a = 0; a < numAdjacent; ++a)
+        {
+            if(used.count(adjacent[a]))
+            {
+                continue;
+            }
+
+            uint32_t first = voronoiMesh.origins[adjacent[a]];
+            uint32_t firstEdges[8];
+            bool closed;
+
+            forward.assign(1, first);
+            forwardEdges.clear();
+            backward.assign(1, first);
+            backwardEdges.clear();
+
+            closed = walkCurve(voronoiMesh, voronoiGraph, first, adjacent[a], first, forward, forwardEdges);
+
+            //  Si first no es un final, la curva sigue también hacia atrás.
+            if(!closed && vertexEdges(voronoiMesh, voronoiGraph, first, firstEdges, 8) == 2)
+            {
+                walkCurve(voronoiMesh, voronoiGraph, first, firstEdges[0] == adjacent[a] ? firstEdges[1] : firstEdges[0],
+                          first, backward, backwardEdges);
+            }
+
+            //  La curva completa en forward: backward al revés y después forward.
+            forward.insert(forward.begin(), backward.rbegin(), backward.rend() - 1);
+            forwardEdges.insert(forwardEdges.begin(), backwardEdges.rbegin(), backwardEdges.rend());
+            used.insert(forwardEdges.begin(), forwardEdges.end());
+
+            bool reverse;
+
+            if(closed)
+            {
+                //  Los lazos empiezan en el origen de su menor segmento y siguen por él.
+                unsigned int e = std::min_element(forwardEdges.begin(), forwardEdges.end()) - forwardEdges.begin();
+
+                forward.pop_back();
+                std::rotate(forward.begin(), forward.begin() + e, forward.end());
+                forward.push_back(forward[0]);
+
+                reverse = forward[0] != voronoiMesh.origins[forwardEdges[e]];
+
+                if(reverse)
+                {
+                    //  Empieza en el otro extremo del segmento: se rota uno más y se recorre al revés.
+                    forward.pop_back();
+                    std::rotate(forward.begin(), forward.begin() + 1, forward.end());
+                    forward.push_back(forward[0]);
+                }
+            }
+            else if(forward.front() != forward.back())
+            {
+                //  Las abiertas empiezan en el extremo de menor id.
+                reverse = forward.back() < forward.front();
+            }
+            else
+            {
+                //  Y si los dos extremos son el mismo vértice, por su menor segmento.
+                reverse = forwardEdges.back() < forwardEdges.front();
+            }
+
+            if(reverse)
+            {
+                std::reverse(forward.begin(), forward.end());
+            }
+
+            for(unsigned int v = 0; v < forward.size(); ++v)
+            {
+                curves.vertices.push_back(voronoiMesh.vertex(forward[v]));
+            }
+
+            curves.offsets.push_back(curves.vertices.size());
+            indexCurve(index, curves, curves.size() - 1, width);
+            ++numAdded;
+        }
+    }
+}
@@ -0,0 +1,171 @@
+//  Comprueba que depixelBanded (banded.cpp) da las mismas curvas que depixel con bandas de varias alturas, en imágenes
+// con líneas diagonales de un píxel que se cruzan: la heurística de curvas mide esas líneas enteras, así que sus cruces
+// dependen de filas muy lejos de la banda.
+//
+//      g++ -std=c++17 -O2 -I. -o banded_seams tests/banded_seams.cpp depixel/*.cpp -lpthread
+//      ./banded_seams
+//
+//  Devuelve 0 si todo coincide.
+
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "depixel/depixel.h"
+
+typedef std::vector<Point> Curve;
+
+static uint32_t randomState = 0x9E3779B9;
+
+//  xorshift32: determinista, para que un fallo se pueda repetir.
+static uint32_t randomWord()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+//  La misma curva sale de las dos formas en el mismo orden: las abiertas empiezan por su extremo menor, y las cerradas
+// por su vértice menor y en el sentido que da la secuencia menor.
+static Curve canonicalCurve(Curve curve)
+{
+    if(curve.size() > 2 && curve.front() == curve.back())
+    {
+        Curve best;
+
+        curve.pop_back();
+
+        for(int side = 0; side < 2; ++side)
+        {
+            for(unsigned int r = 0; r < curve.size(); ++r)
+            {
+                Curve rotated(curve.begin() + r, curve.end());
+
+                rotated.insert(rotated.end(), curve.begin(), curve.begin() + r);
+
+                if(best.empty() || rotated < best)
+                {
+                    best.swap(rotated);
+                }
+            }
+
+            std::reverse(curve.begin(), curve.end());
+        }
+
+        best.push_back(best.front());
+
+        return best;
+    }
+
+    Curve reversed(curve.rbegin(), curve.rend());
+
+    return std::min(curve, reversed);
+}
+
+static void collectCurve(const Point* vertices, unsigned int numVertices, void* userData)
+{
+    ((std::vector<Curve>*)userData)->push_back(canonicalCurve(Curve(vertices, vertices + numVertices)));
+}
+
+static bool sameCurves(const std::vector<uint32_t>& pixels, int width, int height)
+{
+    static const int bandHeights[] = {1, 3, 8, 17};
+    DepixelSplineOptions splineOptions;
+    DepixelResult result;
+    std::vector<Curve> expected;
+
+    //  Las splines no cuentan: sólo se comparan las curvas.
+    splineOptions.maxIterations = 0;
+
+    depixel(&pixels[0], width, height, width * sizeof(uint32_t), result, 1, splineOptions);
+
+    for(unsigned int i = 0; i < result.curves.size(); ++i)
+    {
+        expected.push_back(canonicalCurve(Curve(result.curves.curve(i), result.curves.curve(i) + result.curves.curveSize(i))));
+    }
+
+    freeDepixelResult(result);
+    std::sort(expected.begin(), expected.end());
+
+    for(int bandHeight : bandHeights)
+    {
+        std::vector<Curve> curves;
+
+        depixelBanded(&pixels[0], width, height, width * sizeof(uint32_t), bandHeight, collectCurve, &curves);
+        std::sort(curves.begin(), curves.end());
+
+        if(curves != expected)
+        {
+            printf("Different curves in a %dx%d image with bands of %d rows: %u instead of %u\n", width, height,
+                   bandHeight, (unsigned int)curves.size(), (unsigned int)expected.size());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    std::vector<uint32_t> pixels;
+    unsigned int numImages = 0;
+
+    initAlgorithm();
+
+    //  Una diagonal de toda la imagen cruzada por otra más corta de otro color.
+    pixels.assign(80 * 80, 0xFFFFFFFF);
+
+    for(int i = 0; i < 80; ++i)
+    {
+        pixels[i + i * 80] = 0xFF000000;
+    }
+
+    for(int x = 20; x <= 60; ++x)
+    {
+        pixels[x + (79 - x) * 80] = 0xFFFF0000;
+    }
+
+    if(!sameCurves(pixels, 80, 80))
+    {
+        return 1;
+    }
+
+    ++numImages;
+
+    //  Diagonales al azar, largas y cortas, que se cruzan entre ellas.
+    for(int image = 0; image < 16; ++image)
+    {
+        int width = 60;
+        int height = 300;
+
+        pixels.assign(width * height, 0xFFFFFFFF);
+
+        for(int line = 0; line < 8 + image; ++line)
+        {
+            uint32_t color = 0xFF000000 | (randomWord() & 0xFFFFFF);
+            int x = randomWord() % width;
+            int y = randomWord() % height;
+            int length = 10 + randomWord() % 250;
+            int dx = (randomWord() & 1) ? 1 : -1;
+
+            for(int i = 0; i < length && x >= 0 && x < width && y < height; ++i, x += dx, ++y)
+            {
+                pixels[x + y * width] = color;
+            }
+        }
+
+        if(!sameCurves(pixels, width, height))
+        {
+            return 1;
+        }
+
+        ++numImages;
+    }
+
+    printf("%u images, same curves\n", numImages);
+
+    return 0;
+}
@@ -0,0 +1,132 @@
+//  Rasteriza con rasterizeCells (raster.cpp) imágenes de varios tamaños a escalas no enteras, para compilarlo con
+// AddressSanitizer: con escalas así los lados de las celdas caen casi en el borde de los píxeles, que es donde el
+// rasterizado se salía de su buffer. Comprueba además que una imagen de un solo color sale entera de ese color.
+//
+//      g++ -std=c++17 -O1 -g -fsanitize=address,undefined -I. -o raster_scales tests/raster_scales.cpp depixel/*.cpp -lpthread
+//      ./raster_scales
+//
+//  Devuelve 0 si todo va bien.
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "depixel/depixel.h"
+
+static uint32_t randomState = 0x9E3779B9;
+
+//  xorshift32: determinista, para que un fallo se pueda repetir.
+static uint32_t randomWord()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState;
+}
+
+//  Colores al azar de una paleta pequeña, con líneas diagonales de un píxel como en el pixel art.
+static void makeImage(std::vector<uint32_t>& pixels, int width, int height, unsigned int numColors)
+{
+    uint32_t palette[8];
+
+    for(unsigned int i = 0; i < numColors; ++i)
+    {
+        palette[i] = 0xFF000000 | (randomWord() & 0xFFFFFF);
+    }
+
+    pixels.resize(width * height);
+
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            unsigned int k = (x + y) % 7 == 0 ? 0 : (x - y + height) % 9 == 0 ? 1 : randomWord() % numColors;
+
+            pixels[x + y * width] = palette[k % numColors];
+        }
+    }
+}
+
+static bool rasterize(const std::vector<uint32_t>& pixels, int width, int height, float scale, uint32_t solidColor)
+{
+    DepixelSplineOptions splineOptions;
+    DepixelResult result;
+    int outWidth, outHeight;
+    bool ok = true;
+
+    //  El rasterizado sólo usa las celdas: las splines no hace falta optimizarlas.
+    splineOptions.maxIterations = 0;
+
+    if(!depixel(&pixels[0], width, height, width * sizeof(uint32_t), result, 1, splineOptions))
+    {
+        printf("depixel failed on a %dx%d image\n", width, height);
+        return false;
+    }
+
+    uint32_t* output = rasterizeCells(result, scale, outWidth, outHeight);
+
+    if(!output)
+    {
+        printf("rasterizeCells failed on a %dx%d image at scale %g\n", width, height, scale);
+        ok = false;
+    }
+    else if(solidColor)
+    {
+        for(int i = 0; i < outWidth * outHeight && ok; ++i)
+        {
+            if(output[i] != solidColor)
+            {
+                printf("Pixel %d of a %dx%d solid image at scale %g is %08x instead of %08x\n", i, width, height,
+                       scale, output[i], solidColor);
+                ok = false;
+            }
+        }
+    }
+
+    delete [] output;
+    freeDepixelResult(result);
+
+    return ok;
+}
+
+int main()
+{
+    static const int sizes[][2] = {{1, 1}, {2, 3}, {7, 5}, {16, 16}, {50, 70}, {128, 128}};
+    static const float scales[] = {0.05f, 0.37f, 0.5f, 0.9f, 1.3f, 2.0f, 2.7f, 4.1f};
+    unsigned int numImages = 0;
+    std::vector<uint32_t> pixels;
+
+    initAlgorithm();
+
+    for(const int* size : sizes)
+    {
+        for(float scale : scales)
+        {
+            for(unsigned int numColors = 2; numColors <= 6; numColors += 2)
+            {
+                makeImage(pixels, size[0], size[1], numColors);
+
+                if(!rasterize(pixels, size[0], size[1], scale, 0))
+                {
+                    return 1;
+                }
+
+                ++numImages;
+            }
+
+            pixels.assign(size[0] * size[1], 0xFF3366CC);
+
+            if(!rasterize(pixels, size[0], size[1], scale, 0xFF3366CC))
+            {
+                return 1;
+            }
+
+            ++numImages;
+        }
+    }
+
+    printf("%u images rasterized\n", numImages);
+
+    return 0;
+}
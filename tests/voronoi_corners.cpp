@@ -0,0 +1,533 @@
+//  Comprueba que las tablas de esquinas de extractVoronoiGraph (voronoi.cpp) dan las mismas celdas, con los vértices
+// en el mismo orden, que la escalera de ifs que sustituyeron, copiada aquí tal cual estaba. Recorre las 4096
+// combinaciones de los bits de los que depende la celda central de un grafo de 3x3 (con el resto de bits al azar) y
+// todos los grafos de 1x1 a 3x3 que caben en los bordes: exhaustivo hasta 2 píxeles y al azar a partir de ahí.
+//
+//      g++ -std=c++17 -O2 -I. -o voronoi_corners tests/voronoi_corners.cpp depixel/*.cpp -lpthread
+//      ./voronoi_corners
+//
+//  Devuelve 0 si todo coincide; si no, muestra el primer grafo distinto.
+
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "depixel/depixel.h"
+
+#define LADDER_MAX_CELL_VERTICES 8
+
+static VoronoiGraph ladderExtractVoronoiGraph(uint8_t* similarityGraph, int width, int height)
+{
+    VoronoiGraph voronoiGraph;
+    unsigned int numPixels = width * height;
+
+    //  Una sola reserva: los offsets y, detrás, los vértices (2 bytes cada uno, así que caben 4 por unsigned int).
+    voronoiGraph.width = width;
+    voronoiGraph.height = height;
+    voronoiGraph.offsets = new unsigned int[numPixels + 1 + numPixels * LADDER_MAX_CELL_VERTICES / 2];
+    voronoiGraph.vertices = (int8_t*)(voronoiGraph.offsets + numPixels + 1);
+    voronoiGraph.offsets[0] = 0;
+
+    int8_t* vertex = voronoiGraph.vertices;
+    int x, y, prevline, nextline;
+    uint8_t* sg = similarityGraph;
+    unsigned int w[10];
+
+    Point voronoiPoint, pointAux;
+    //unsigned int conns;
+
+    Point voronoiCell[LADDER_MAX_CELL_VERTICES];
+    unsigned int numPoints = 0;
+
+    for(y = 0; y < height; ++y)
+    {
+        if(y > 0)
+        {
+            prevline = -width;
+        }
+        else
+        {
+            prevline = 0;
+        }
+
+        if(y < height - 1)
+        {
+            nextline = width;
+        }
+        else
+        {
+            nextline = 0;
+        }
+
+        for(x = 0; x < width; ++x)
+        {
+            w[2] = *(sg + prevline);
+            w[5] = *sg;
+            w[8] = *(sg + nextline);
+
+            if(x > 0)
+            {
+                w[1] = *(sg + prevline - 1);
+                w[4] = *(sg - 1);
+                w[7] = *(sg + nextline - 1);
+            }
+            else
+            {
+                w[1] = w[2];
+                w[4] = w[5];
+                w[7] = w[8];
+            }
+
+            if(x < width - 1)
+            {
+                w[3] = *(sg + prevline + 1);
+                w[6] = *(sg + 1);
+                w[9] = *(sg + nextline + 1);
+            }
+            else
+            {
+                w[3] = w[2];
+                w[6] = w[5];
+                w[9] = w[8];
+            }
+
+            numPoints = 0;
+
+            //  Según organización de las conexiones, hay que construir la celula...
+            // Voy a ponerlas todas como puntos de entre (0,0) y (8, 8). Posteriormente optimizaré esto.
+            if(y > 0)
+            {
+                //  Si arriba hay diagonal abajo a la izquierda
+                if(w[2] & 0x20)
+                {
+                    voronoiPoint = std::make_pair(1, 1);
+                    voronoiCell[numPoints++] = (voronoiPoint);
+
+                }
+                else if(w[5] & 0x01) // Si no existiera esa conexión, comprobemos si la central tiene una arriba-izquierda
+                {
+                    voronoiPoint = std::make_pair(1, -1);
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+                else
+                {
+                    voronoiPoint = std::make_pair(0, 0);
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+
+                //  Si arriba hay diagonal abajo a la derecha
+                if(w[2] & 0x80)
+                {
+                    voronoiPoint = std::make_pair(3, 1);
+                    voronoiCell[numPoints++] = (voronoiPoint);
+
+                }
+                else if(w[5] & 0x04) // Si no existiera esa conexión, comprobemos si la central tiene una arriba-derecha
+                {
+                    voronoiPoint = std::make_pair(3, -1);
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+                else
+                {
+                    voronoiPoint = std::make_pair(4, 0);
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+            }
+            else
+            {
+                voronoiCell[numPoints++] = (std::make_pair(0, 0));
+
+                voronoiPoint = std::make_pair(4, 0);
+                voronoiCell[numPoints++] = (voronoiPoint);
+            }
+
+            if(x < width - 1)
+            {
+                //  Si a la derecha hay diagonal arriba-izquierda
+                if(w[6] & 0x01)
+                {
+                    pointAux = std::make_pair(3, 1);
+                    if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else if(w[5] & 0x04) // Si no existiera esa conexión, comprobemos si la central tiene una arriba-derecha
+                {
+                    //pointAux = std::make_pair(3, 1);
+                    //if(voronoiPoint != pointAux)
+                    //{
+                        voronoiPoint = std::make_pair(5, 1); //pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    //}
+                }
+                else
+                {
+                    pointAux = std::make_pair(4, 0);
+                    if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+
+                //  Si a la derecha hay diagonal abajo-izquierda
+                if(w[6] & 0x20)
+                {
+                    //if(voronoiPoint != std::make_pair(3, 1))
+                    {
+                        voronoiPoint = std::make_pair(3, 3);
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else if(w[5] & 0x80) // Si no existiera esa conexión, comprobemos si la central tiene una abajo-derecha
+                {
+                    //pointAux = std::make_pair(3, 1);
+                    //if(voronoiPoint != pointAux)
+                    //{
+                        voronoiPoint = std::make_pair(5, 3); //pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    //}
+                }
+                else
+                {
+                    //if(voronoiPoint != std::make_pair(3, 0))
+                    {
+                        voronoiPoint = std::make_pair(4, 4);
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+            }
+            else
+            {
+                pointAux = std::make_pair(4, 0);
+                if(voronoiPoint != pointAux)
+                {
+                    voronoiPoint = pointAux;
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+
+                pointAux = std::make_pair(4, 4);
+                if(voronoiPoint != pointAux)
+                {
+                    voronoiPoint = pointAux;
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+            }
+
+            if(y < height - 1)
+            {
+                //  Si abajo hay diagonal arriba-derecha
+                if(w[8] & 0x04)
+                {
+                    pointAux = std::make_pair(3, 3);
+                    if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else if(w[5] & 0x80) // Si no existiera esa conexión, comprobemos si la central tiene una abajo-derecha
+                {
+                    //pointAux = std::make_pair(3, 1);
+                    //if(voronoiPoint != pointAux)
+                    //{
+                        voronoiPoint = std::make_pair(3, 5); //pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    //}
+                }
+                else
+                {
+                    pointAux = std::make_pair(4, 4);
+                    if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+
+                //  Si abajo hay diagonal arriba-izquierda
+                if(w[8] & 0x01)
+                {
+                    //if(voronoiPoint != std::make_pair(3, 1))
+                    {
+                        voronoiPoint = std::make_pair(1, 3);
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else if(w[5] & 0x20) // Si no existiera esa conexión, comprobemos si la central tiene una abajo-izquierda
+                {
+                    //pointAux = std::make_pair(3, 1);
+                    //if(voronoiPoint != pointAux)
+                    //{
+                        voronoiPoint = std::make_pair(1, 5); //pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    //}
+                }
+                else
+                {
+                    //if(voronoiPoint != std::make_pair(3, 0))
+                    {
+                        voronoiPoint = std::make_pair(0, 4);
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+            }
+            else
+            {
+                pointAux = std::make_pair(4, 4);
+                if(voronoiPoint != pointAux)
+                {
+                    voronoiPoint = pointAux;
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+
+                pointAux = std::make_pair(0, 4);
+                if(voronoiPoint != pointAux)
+                {
+                    voronoiPoint = pointAux;
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+            }
+
+            if(x > 0)
+            {
+                //  Si a la izquierda hay diagonal abajo-derecha
+                if(w[4] & 0x80)
+                {
+                    pointAux = std::make_pair(1, 3);
+                    if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else if(w[5] & 0x20) // Si no existiera esa conexión, comprobemos si la central tiene una abajo-izquierda
+                {
+                    //pointAux = std::make_pair(3, 1);
+                    //if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = std::make_pair(-1, 3); //pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else
+                {
+                    pointAux = std::make_pair(0, 4);
+                    if(voronoiPoint != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+
+                //  Si a la izquierda hay diagonal arriba-derecha
+                if(w[4] & 0x04)
+                {
+
+                    pointAux = std::make_pair(1, 1);
+                    if(voronoiCell[0] != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else if(w[5] & 0x01) // Si no existiera esa conexión, comprobemos si la central tiene una arriba-izquierda
+                {
+                    //pointAux = std::make_pair(3, 1);
+                    //if(voronoiCell[0] != pointAux)
+                    {
+                        voronoiPoint = std::make_pair(-1, 1); //pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+                else
+                {
+                    pointAux = std::make_pair(0, 0);
+                    if(voronoiCell[0] != pointAux)
+                    {
+                        voronoiPoint = pointAux;
+                        voronoiCell[numPoints++] = (voronoiPoint);
+                    }
+                }
+            }
+            else
+            {
+                pointAux = std::make_pair(0, 4);
+                if(voronoiPoint != pointAux)
+                {
+                    voronoiPoint = pointAux;
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+
+                pointAux = std::make_pair(0, 0);
+                if(voronoiCell[0] != pointAux)
+                {
+                    voronoiPoint = pointAux;
+                    voronoiCell[numPoints++] = (voronoiPoint);
+                }
+            }
+
+            for(unsigned int i = 0; i < numPoints; ++i)
+            {
+                *vertex++ = voronoiCell[i].first;
+                *vertex++ = voronoiCell[i].second;
+            }
+
+            voronoiGraph.offsets[x + y * width + 1] = voronoiGraph.offsets[x + y * width] + numPoints;
+            numPoints = 0;
+            ++sg;
+        }
+    }
+
+    return voronoiGraph;
+}
+
+static uint32_t randomState = 0x9E3779B9;
+
+//  xorshift32: determinista, para que un fallo se pueda repetir.
+static uint8_t randomByte()
+{
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    return randomState >> 24;
+}
+
+static bool sameCells(std::vector<uint8_t>& graph, int width, int height)
+{
+    VoronoiGraph ladder = ladderExtractVoronoiGraph(&graph[0], width, height);
+    VoronoiGraph tables = extractVoronoiGraph(&graph[0], width, height);
+    bool same = true;
+
+    for(int i = 0; i <= width * height && same; ++i)
+    {
+        same = ladder.offsets[i] == tables.offsets[i];
+    }
+
+    for(unsigned int i = 0; i < ladder.offsets[width * height] * 2 && same; ++i)
+    {
+        same = ladder.vertices[i] == tables.vertices[i];
+    }
+
+    if(!same)
+    {
+        printf("Different cells in a %dx%d graph:", width, height);
+
+        for(int i = 0; i < width * height; ++i)
+        {
+            printf(" %02x", graph[i]);
+        }
+
+        printf("\n");
+    }
+
+    freeVoronoiGraph(ladder);
+    freeVoronoiGraph(tables);
+
+    return same;
+}
+
+static void setBit(std::vector<uint8_t>& graph, int pixel, uint8_t bit, bool on)
+{
+    if(on)
+    {
+        graph[pixel] |= bit;
+    }
+    else
+    {
+        graph[pixel] &= ~bit;
+    }
+}
+
+int main()
+{
+    unsigned long numGraphs = 0;
+    std::vector<uint8_t> graph;
+
+    //  Celda central de 3x3: sus 4 diagonales y las 2 de cada vecino lateral que cruzan hacia sus esquinas.
+    graph.resize(9);
+
+    for(unsigned int key = 0; key < 4096; ++key)
+    {
+        for(int sample = 0; sample < 16; ++sample)
+        {
+            for(int i = 0; i < 9; ++i)
+            {
+                graph[i] = randomByte();
+            }
+
+            setBit(graph, 1, 0x20, key & 0x001);
+            setBit(graph, 1, 0x80, key & 0x002);
+            setBit(graph, 3, 0x80, key & 0x004);
+            setBit(graph, 3, 0x04, key & 0x008);
+            setBit(graph, 5, 0x01, key & 0x010);
+            setBit(graph, 5, 0x20, key & 0x020);
+            setBit(graph, 7, 0x04, key & 0x040);
+            setBit(graph, 7, 0x01, key & 0x080);
+            setBit(graph, 4, 0x01, key & 0x100);
+            setBit(graph, 4, 0x04, key & 0x200);
+            setBit(graph, 4, 0x20, key & 0x400);
+            setBit(graph, 4, 0x80, key & 0x800);
+
+            if(!sameCells(graph, 3, 3))
+            {
+                return 1;
+            }
+
+            ++numGraphs;
+        }
+    }
+
+    //  Bordes: todos los grafos de 1 y 2 píxeles, y al azar los de 2x2 a 3x3.
+    for(int height = 1; height <= 3; ++height)
+    {
+        for(int width = 1; width <= 3; ++width)
+        {
+            int numPixels = width * height;
+
+            graph.resize(numPixels);
+
+            if(numPixels <= 2)
+            {
+                for(unsigned int bits = 0; bits < (1u << (8 * numPixels)); ++bits)
+                {
+                    for(int i = 0; i < numPixels; ++i)
+                    {
+                        graph[i] = bits >> (8 * i);
+                    }
+
+                    if(!sameCells(graph, width, height))
+                    {
+                        return 1;
+                    }
+
+                    ++numGraphs;
+                }
+
+                continue;
+            }
+
+            for(int sample = 0; sample < 65536; ++sample)
+            {
+                for(int i = 0; i < numPixels; ++i)
+                {
+                    graph[i] = randomByte();
+                }
+
+                if(!sameCells(graph, width, height))
+                {
+                    return 1;
+                }
+
+                ++numGraphs;
+            }
+        }
+    }
+
+    printf("%lu graphs, same cells\n", numGraphs);
+
+    return 0;
+}